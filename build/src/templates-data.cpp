@@ -0,0 +1,243 @@
+/* generated by mt-api-gentpl, do not edit */
+
+#include "template.h"
+
+/* error.html */
+static const char tplText1[] =
+	"    <div class='errorDiv'>\n"
+	"      <span class='errorText1'>Error</span> <span class='errorNum'>@@@ERR_NUM@@@</span>\n"
+	"      <div class='errorTextDiv'>\n"
+	"        <span class='errorText2'>@@@ERR_TXT@@@</span>\n"
+	"      </div>\n"
+	"    </div>\n";
+static const CTemplate::segment_t tplSegments1[] = {
+	{ 0, 94, false },
+	{ 97, 7, true }, /* ERR_NUM */
+	{ 107, 74, false },
+	{ 184, 7, true }, /* ERR_TXT */
+	{ 194, 32, false },
+};
+
+/* footer.html */
+static const char tplText2[] =
+	"<div class='main-footer-div'>\n"
+	"  <table class=\"main-footer-tab\">\n"
+	"    <tr>\n"
+	"      <td style='width: 50%;' class=\"main-footer-copyR\"><pre>Using:      sql-formatter\n"
+	"Copyright:  &copy; 2016-2017, Uku Pattak\n"
+	"License:    MIT\n"
+	"URL:        <a href='https://github.com/zeroturnaround/sql-formatter' target='_blank'>https://github.com/zeroturnaround/sql-formatter</a></pre>\n"
+	"      </td>\n"
+	"      <td style='width: 50%;' class=\"main-footer-copyR\">&nbsp;</td>\n"
+	"    </tr>\n"
+	"  </table>\n"
+	"</div>\n"
+	"</body></html>\n";
+static const CTemplate::segment_t tplSegments2[] = {
+	{ 0, 484, false },
+};
+
+/* index.html */
+static const char tplText3[] =
+	"    <div class='indexDiv'>\n"
+	"      <span class='indexText1'>Huhu...</span>\n"
+	"      <div class='indexTextDiv'>\n"
+	"        <span class='indexText2'>Noch nichts zu sehen es hier gibt.</span>\n"
+	"      </div>\n"
+	"    </div>\n";
+static const CTemplate::segment_t tplSegments3[] = {
+	{ 0, 205, false },
+};
+
+/* json-format.html */
+static const char tplText4[] =
+	"<script type=\"text/javascript\">\n"
+	"  jsonBox(\"@@@JSON_DATA@@@\");\n"
+	"</script>\n";
+static const CTemplate::segment_t tplSegments4[] = {
+	{ 0, 43, false },
+	{ 46, 9, true }, /* JSON_DATA */
+	{ 58, 14, false },
+};
+
+/* main-body.html */
+static const char tplText5[] =
+	"    <link rel=\"stylesheet\" type=\"text/css\" href=\"/css/main.css\" />\n"
+	"    <script type=\"text/javascript\" src=\"/js/base64.js\"></script>\n"
+	"    <script type=\"text/javascript\" src=\"/js/main.js\"></script>\n"
+	"    <script type=\"text/javascript\" src=\"/js/sql-formatter.min.js\"></script>\n"
+	"  </head>\n"
+	"  <body>\n"
+	"\n"
+	"    <table class=\"formatTable\">\n"
+	"      <tr>\n"
+	"        <td class=\"formatTD\" style=\"width: 40%\">\n"
+	"          <div class=\"jsonInput\">\n"
+	"            <form action=\"/api.html\" method=\"post\" accept-charset=\"UTF-8\" onSubmit='if (data1.value == \"\") data1.value = \"{}\";'>\n"
+	"              <textarea name=\"data1\" cols=\"50\" rows=\"10\">@@@JSON_TEXTAREA@@@</textarea>\n"
+	"              <br />\n"
+	"              <input type=\"submit\" value=\" send post data \" />\n"
+	"            </form>\n"
+	"            <table class=\"buttonTable\">\n"
+	"              <tr>\n"
+	"                <td class=\"buttonTD\">\n"
+	"                  <form action=\"/api.html\" method=\"get\" accept-charset=\"UTF-8\">\n"
+	"                    <input type=\"submit\" value=\" reset \" />\n"
+	"                  </form>\n"
+	"                </td>\n"
+	"                <td class=\"buttonTD\">\n"
+	"                  <form action=\"/api/info\" method=\"get\" accept-charset=\"UTF-8\">\n"
+	"                    <input type=\"submit\" value=\" prog info \" />\n"
+	"                  </form>\n"
+	"                </td>\n"
+	"                <td class=\"buttonTD\">\n"
+	"                  <form action=\"/api/listLivestream\" method=\"get\" accept-charset=\"UTF-8\">\n"
+	"                    <input type=\"submit\" value=\" list livestreams \" />\n"
+	"                  </form>\n"
+	"                </td>\n"
+	"                <td class=\"buttonTD\">\n"
+	"                  <form action=\"/api/listChannels\" method=\"get\" accept-charset=\"UTF-8\">\n"
+	"                    <input type=\"submit\" value=\" list channels \" />\n"
+	"                  </form>\n"
+	"                </td>\n"
+	"              </tr>\n"
+	"            </table>\n"
+	"          </div>\n"
+	"        </td>\n"
+	"        <td class=\"formatTD\">\n"
+	"          <div class=\"msgDiv\"><pre class=\"msgPre\" id=\"msgPre\"></pre></div>\n"
+	"        </td>\n"
+	"      </tr>\n"
+	"    </table>\n"
+	"    <hr style='width: 80%;'>\n"
+	"\n"
+	"    <div id=\"sqlContainer\">\n"
+	"      <div id=\"sqlHeader\">\n"
+	"        <div id=\"sqlHeader_inner\">\n"
+	"          <span id=\"spoiler1_txt\" class=\"spoiler1_txt\" onclick=\"sqlSpoiler();\">&nbsp;</span>\n"
+	"        </div>\n"
+	"      </div>\n"
+	"      <div id=\"sql_0\">\n"
+	"        <div id=\"sql_1\">\n"
+	"          <div id=\"sqlCode_1\">&nbsp;</div>\n"
+	"          <div id=\"sqlInfo_1\" class=\"sqlInfo\"></div>\n"
+	"        </div>\n"
+	"        <div id=\"sql_2\">\n"
+	"          <div id=\"sqlCode_2\">&nbsp;</div>\n"
+	"          <div id=\"sqlInfo_2\" class=\"sqlInfo\"></div>\n"
+	"        </div>\n"
+	"        <div id=\"sqlFooter\"></div>\n"
+	"      </div>\n"
+	"    </div>\n"
+	"    <hr style='width: 80%;'>\n"
+	"    <div id=\"jsonContainer\">\n"
+	"      <div id=\"jsonHeader\">\n"
+	"        <span class=\"jsonheader_txt\">Json Output</span>\n"
+	"      </div>\n"
+	"      <div id=\"jsonContainer_inner\">&nbsp;</div>\n"
+	"    </div>\n"
+	"<script type=\"text/javascript\">\n"
+	"  setFirstData();\n"
+	"</script>\n";
+static const CTemplate::segment_t tplSegments5[] = {
+	{ 0, 603, false },
+	{ 606, 13, true }, /* JSON_TEXTAREA */
+	{ 622, 2206, false },
+};
+
+/* msgbox.html */
+static const char tplText6[] =
+	"<script type=\"text/javascript\">\n"
+	"  addTextMsgBox(\"@@@MSGTXT@@@\");\n"
+	"</script>\n";
+static const CTemplate::segment_t tplSegments6[] = {
+	{ 0, 49, false },
+	{ 52, 6, true }, /* MSGTXT */
+	{ 61, 14, false },
+};
+
+/* sql-format.html */
+static const char tplText7[] =
+	"<script type=\"text/javascript\">\n"
+	"  sqlBox(\"@@@SQL_DATA@@@\", \"@@@ID@@@\");\n"
+	"</script>\n";
+static const CTemplate::segment_t tplSegments7[] = {
+	{ 0, 42, false },
+	{ 45, 8, true }, /* SQL_DATA */
+	{ 56, 4, false },
+	{ 63, 2, true }, /* ID */
+	{ 68, 14, false },
+};
+
+/* sql-info.html */
+static const char tplText8[] =
+	"<script type=\"text/javascript\">\n"
+	"  sqlInfoBox(\"@@@INFO_DATA@@@\", \"@@@ID@@@\");\n"
+	"</script>\n";
+static const CTemplate::segment_t tplSegments8[] = {
+	{ 0, 46, false },
+	{ 49, 9, true }, /* INFO_DATA */
+	{ 61, 4, false },
+	{ 68, 2, true }, /* ID */
+	{ 73, 14, false },
+};
+
+/* test_1.json */
+static const char tplText9[] =
+	"{\n"
+	"    \"software\": \"Neutrino Mediathek\",\n"
+	"    \"vMajor\": 0,\n"
+	"    \"vMinor\": 3,\n"
+	"    \"isBeta\": true,\n"
+	"    \"vBeta\": 1,\n"
+	"    \"mode\": 5,\n"
+	"    \"data\": {\n"
+	"        \"channel\": \"ARD\",\n"
+	"        \"timeMode\": 2,\n"
+	"        \"epoch\": -1,\n"
+	"        \"duration\": 0,\n"
+	"        \"limit\": 5,\n"
+	"        \"start\": 0,\n"
+	"        \"refTime\": 0\n"
+	"    }\n"
+	"}\n";
+static const CTemplate::segment_t tplSegments9[] = {
+	{ 0, 301, false },
+};
+
+/* timing.html */
+static const char tplText10[] =
+	"    <hr style='width: 80%;'>\n"
+	"    <div id=\"timingContainer\">\n"
+	"      <div id=\"timingHeader\">\n"
+	"        <span class=\"timingheader_txt\">Timing @@@REQ_ID@@@ (@@@TOTAL@@@ ms)</span>\n"
+	"      </div>\n"
+	"      <div id=\"timingContainer_inner\">\n"
+	"        <table class=\"timingTable\">\n"
+	"@@@ROWS@@@\n"
+	"        </table>\n"
+	"      </div>\n"
+	"    </div>\n";
+static const CTemplate::segment_t tplSegments10[] = {
+	{ 0, 136, false },
+	{ 139, 6, true }, /* REQ_ID */
+	{ 148, 2, false },
+	{ 153, 5, true }, /* TOTAL */
+	{ 161, 100, false },
+	{ 264, 4, true }, /* ROWS */
+	{ 271, 42, false },
+};
+
+const CTemplate::compiled_t g_templates[] = {
+	{ "error.html", tplText1, 226, tplSegments1, 5 },
+	{ "footer.html", tplText2, 484, tplSegments2, 1 },
+	{ "index.html", tplText3, 205, tplSegments3, 1 },
+	{ "json-format.html", tplText4, 72, tplSegments4, 3 },
+	{ "main-body.html", tplText5, 2828, tplSegments5, 3 },
+	{ "msgbox.html", tplText6, 75, tplSegments6, 3 },
+	{ "sql-format.html", tplText7, 82, tplSegments7, 5 },
+	{ "sql-info.html", tplText8, 87, tplSegments8, 5 },
+	{ "test_1.json", tplText9, 301, tplSegments9, 1 },
+	{ "timing.html", tplText10, 313, tplSegments10, 7 },
+};
+const size_t g_templateCount = sizeof(g_templates) / sizeof(g_templates[0]);
@@ -6,6 +6,7 @@ API_DIST_DIR=${API_DIST_DIR:-/opt/api.dist}
 WWW_DIR="${API_HOME}/www"
 DATA_DIR="${API_HOME}/data"
 LOG_DIR="${API_HOME}/log"
+CACHE_DIR="${API_HOME}/cache"
 CONFIG_DIR="${API_HOME}/config"
 BIN_DIR="${API_HOME}/bin"
 BINARY_PATH="${BIN_DIR}/mt-api"
@@ -17,8 +18,8 @@ MT_API_DB_PORT=${MT_API_DB_PORT:-3306}
 MT_API_DB_NAME=${MT_API_DB_NAME:-mediathek_1}
 export MT_API_DB_HOST MT_API_DB_PORT MT_API_DB_NAME
 
-mkdir -p "${WWW_DIR}" "${DATA_DIR}" "${DATA_DIR}/.passwd" "${LOG_DIR}" "${CONFIG_DIR}" "${BIN_DIR}"
-chown www-data:www-data "${LOG_DIR}"
+mkdir -p "${WWW_DIR}" "${DATA_DIR}" "${DATA_DIR}/.passwd" "${LOG_DIR}" "${CACHE_DIR}" "${CONFIG_DIR}" "${BIN_DIR}"
+chown www-data:www-data "${LOG_DIR}" "${CACHE_DIR}"
 
 if [[ -d "${API_DIST_DIR}/www" ]] && [[ ! -f "${WWW_DIR}/mt-api.cgi" ]]; then
   echo "[api-entrypoint] Populating www/ from defaults."
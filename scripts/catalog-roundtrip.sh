@@ -0,0 +1,84 @@
+#!/usr/bin/env bash
+#
+# Catalog patch round trip: generates three versions of a synthetic
+# catalogue with mt-api-gendata (old rows expire, new rows arrive, some
+# rows change in place), builds the patches v1 -> v2 -> v3 with the
+# server code and applies both to the v1 dump the way a client does.
+# The result has to match the v3 dump.
+#
+# Run from the repository root or from scripts/; see --help.
+set -euo pipefail
+
+REPO_DIR="$(cd "$(dirname "$0")/.." && pwd)"
+BUILD_DIR="${REPO_DIR}/build"
+MAKE_ARGS="${MAKE_ARGS:-}"
+
+ROWS=20000
+BUILD=1
+WORK_DIR=""
+
+usage() {
+  cat <<EOF
+Usage: $0 [options]
+  --rows N           rows of the first version (default ${ROWS})
+  --no-build         use the binaries in ${BUILD_DIR} as they are
+EOF
+}
+
+while (($#)); do
+  case "$1" in
+    --rows) ROWS="$2"; shift 2 ;;
+    --no-build) BUILD=0; shift ;;
+    -h|--help) usage; exit 0 ;;
+    *) usage; exit 1 ;;
+  esac
+done
+
+log() {
+  echo "[catalog-roundtrip] $*"
+}
+
+cleanup() {
+  if [[ -n "${WORK_DIR}" ]]; then
+    rm -rf "${WORK_DIR}"
+  fi
+}
+trap cleanup EXIT
+
+if [[ "${BUILD}" == "1" ]]; then
+  log "Building tools"
+  make -C "${REPO_DIR}" -j"$(nproc)" ${MAKE_ARGS} \
+    "${BUILD_DIR}/mt-api-gendata" "${BUILD_DIR}/mt-api-catalog" >/dev/null
+fi
+
+WORK_DIR="$(mktemp -d)"
+GENDATA="${BUILD_DIR}/mt-api-gendata"
+CATALOG="${BUILD_DIR}/mt-api-catalog"
+DATE=1700000000
+
+# v2 drops the first 5% and adds 10%, v3 drops another 10% and adds 5%;
+# --edit changes every 97th row, a different set in each version.
+gen() {
+  local ver="$1" skip="$2" rows="$3"
+  "${GENDATA}" --rows "${rows}" --skip "${skip}" --date "${DATE}" --edit 97 \
+    --version "${ver}" --catalog "${WORK_DIR}/catalog-${ver}.mtc.gz" 2>/dev/null
+}
+gen 1 0 "${ROWS}"
+gen 2 $((ROWS / 20)) $((ROWS + ROWS / 10))
+gen 3 $((ROWS / 20 + ROWS / 10)) $((ROWS + ROWS / 10 + ROWS / 20))
+
+"${CATALOG}" patch "${WORK_DIR}/catalog-1.mtc.gz" "${WORK_DIR}/catalog-2.mtc.gz" "${WORK_DIR}/patch-1-2.mtp.gz"
+"${CATALOG}" patch "${WORK_DIR}/catalog-2.mtc.gz" "${WORK_DIR}/catalog-3.mtc.gz" "${WORK_DIR}/patch-2-3.mtp.gz"
+log "Patch sizes: $(stat -c '%n %s' "${WORK_DIR}"/patch-*.mtp.gz | sed "s|${WORK_DIR}/||" | tr '\n' ' ')"
+
+"${CATALOG}" apply "${WORK_DIR}/catalog-1.mtc.gz" \
+  "${WORK_DIR}/patch-1-2.mtp.gz" "${WORK_DIR}/patch-2-3.mtp.gz" "${WORK_DIR}/client.mtc.gz"
+"${CATALOG}" compare "${WORK_DIR}/client.mtc.gz" "${WORK_DIR}/catalog-3.mtc.gz"
+
+# A patch applied to the wrong base version has to be refused.
+if "${CATALOG}" apply "${WORK_DIR}/catalog-1.mtc.gz" "${WORK_DIR}/patch-2-3.mtp.gz" \
+     "${WORK_DIR}/wrong.mtc.gz" 2>/dev/null; then
+  log "FAILED: patch 2-3 applied to version 1"
+  exit 1
+fi
+log "OK"
@@ -0,0 +1,319 @@
+#!/usr/bin/env bash
+#
+# End-to-end benchmark: builds mt-api, the data generator and the replay
+# tool, loads a synthetic catalogue into a throwaway backend, records a
+# realistic request mix through the CGI binary and replays it against
+# the deployment modes that are available on this machine:
+#
+#   cgi               - fork/exec of the binary per request (mt-api-replay --cgi)
+#   cgi-via-fcgiwrap  - fcgiwrap behind a FastCGI socket, still one CGI
+#                       process per request (needs spawn-fcgi, fcgiwrap)
+#   http              - lighttpd with mod_cgi (needs lighttpd)
+#
+# mt-api is a CGI program in every mode; there is no native FastCGI or
+# server mode.
+# Run from the repository root or from scripts/; see --help.
+set -euo pipefail
+
+REPO_DIR="$(cd "$(dirname "$0")/.." && pwd)"
+BUILD_DIR="${REPO_DIR}/build"
+MAKE_ARGS="${MAKE_ARGS:-}"
+
+BACKEND="catalog"
+SCALE="0.1"
+REQUESTS=2000
+CONCURRENCY=4
+MODES="cgi cgi-via-fcgiwrap http"
+WORK_DIR=""
+KEEP=0
+BUILD=1
+PORT_BASE=18700
+
+usage() {
+  cat <<EOF
+Usage: $0 [options]
+  --backend NAME     catalog, sqlite or mariadb (default ${BACKEND})
+  --scale F          catalogue size for mt-api-gendata (default ${SCALE})
+  --requests N       requests per mode (default ${REQUESTS})
+  --concurrency N    parallel requests (default ${CONCURRENCY})
+  --modes LIST       modes to run, e.g. "cgi http" (default "${MODES}")
+  --work DIR         working directory (default: a new temporary directory)
+  --keep             keep the working directory
+  --no-build         use the binaries in ${BUILD_DIR} as they are
+
+Extra make variables can be passed via MAKE_ARGS, e.g.
+  MAKE_ARGS="ENABLE_ZSTD=1" $0 --backend mariadb
+EOF
+}
+
+while (($#)); do
+  case "$1" in
+    --backend) BACKEND="$2"; shift 2 ;;
+    --scale) SCALE="$2"; shift 2 ;;
+    --requests) REQUESTS="$2"; shift 2 ;;
+    --concurrency) CONCURRENCY="$2"; shift 2 ;;
+    --modes) MODES="$2"; shift 2 ;;
+    --work) WORK_DIR="$2"; shift 2 ;;
+    --keep) KEEP=1; shift ;;
+    --no-build) BUILD=0; shift ;;
+    -h|--help) usage; exit 0 ;;
+    *) usage; exit 1 ;;
+  esac
+done
+
+case "${BACKEND}" in
+  catalog|sqlite|mariadb) ;;
+  *) echo "Unknown backend '${BACKEND}'." >&2; exit 1 ;;
+esac
+
+log() {
+  echo "[e2e-bench] $*"
+}
+
+PIDS=()
+cleanup() {
+  for pid in "${PIDS[@]}"; do
+    kill "${pid}" 2>/dev/null || true
+  done
+  wait 2>/dev/null || true
+  if [[ "${KEEP}" == "0" ]] && [[ -n "${WORK_DIR}" ]]; then
+    rm -rf "${WORK_DIR}"
+  elif [[ -n "${WORK_DIR}" ]]; then
+    log "Working directory kept: ${WORK_DIR}"
+  fi
+}
+trap cleanup EXIT
+
+if [[ -z "${WORK_DIR}" ]]; then
+  WORK_DIR="$(mktemp -d "${TMPDIR:-/tmp}/mt-api-e2e.XXXXXX")"
+else
+  mkdir -p "${WORK_DIR}"
+  WORK_DIR="$(cd "${WORK_DIR}" && pwd)"
+fi
+
+# --- build -----------------------------------------------------------------
+
+if [[ "${BUILD}" == "1" ]]; then
+  log "Building mt-api, mt-api-gendata and mt-api-replay."
+  # shellcheck disable=SC2086
+  make -C "${REPO_DIR}" -j"$(nproc)" ${MAKE_ARGS} \
+    build/mt-api build/mt-api-gendata build/mt-api-replay >/dev/null
+fi
+
+# --- install layout ----------------------------------------------------------
+
+WWW_DIR="${WORK_DIR}/www"
+DATA_DIR="${WORK_DIR}/data"
+BINARY="${WWW_DIR}/mt-api"
+mkdir -p "${WWW_DIR}" "${DATA_DIR}" "${WORK_DIR}/log" "${WORK_DIR}/cache"
+cp -a "${REPO_DIR}/src/web/data/." "${DATA_DIR}/"
+mkdir -p "${DATA_DIR}/.passwd"
+echo "bench:bench" > "${DATA_DIR}/.passwd/sqlpasswd"
+cp "${BUILD_DIR}/mt-api" "${BINARY}"
+
+export DOCUMENT_ROOT="${WWW_DIR}"
+export MT_API_SLOW_QUERY_MS=-1
+# all requests come from one address, the limits would measure themselves
+export MT_API_RATE_LIMIT=0 MT_API_MAX_DB_REQUESTS=0
+
+# --- data and backend ----------------------------------------------------------
+
+CATALOG="${WORK_DIR}/catalog.mtc.gz"
+GENDATA_ARGS=(--scale "${SCALE}" --catalog "${CATALOG}")
+if [[ "${BACKEND}" == "mariadb" ]]; then
+  GENDATA_ARGS+=(--sql "${WORK_DIR}/video.sql")
+fi
+log "Generating data (scale ${SCALE})."
+"${BUILD_DIR}/mt-api-gendata" "${GENDATA_ARGS[@]}"
+
+case "${BACKEND}" in
+  catalog)
+    export MT_API_DB_BACKEND=catalog MT_API_DB_FILE="${CATALOG}"
+    ;;
+  sqlite)
+    # the catalog backend leaves its import as a SQLite file in the cache
+    MT_API_DB_BACKEND=catalog MT_API_DB_FILE="${CATALOG}" QUERY_STRING="mode=api&sub=info" \
+      REQUEST_METHOD=GET "${BINARY}" </dev/null >/dev/null
+    export MT_API_DB_BACKEND=sqlite
+    MT_API_DB_FILE="$(ls "${WORK_DIR}"/cache/sqlite/catalog-*.sqlite)"
+    export MT_API_DB_FILE
+    ;;
+  mariadb)
+    for tool in mariadb-install-db mariadbd mariadb mariadb-admin; do
+      if ! command -v "${tool}" >/dev/null; then
+        echo "'${tool}' not found, install mariadb-server for --backend mariadb." >&2
+        exit 1
+      fi
+    done
+    DB_PORT=$((PORT_BASE + 6))
+    DB_SOCKET="${WORK_DIR}/mysql.sock"
+    log "Starting a throwaway MariaDB on port ${DB_PORT}."
+    mariadb-install-db --no-defaults --datadir="${WORK_DIR}/mysql" --auth-root-authentication-method=normal \
+      --skip-test-db >"${WORK_DIR}/log/mariadb-install.log" 2>&1
+    mariadbd --no-defaults --datadir="${WORK_DIR}/mysql" --socket="${DB_SOCKET}" --port="${DB_PORT}" \
+      --bind-address=127.0.0.1 --skip-grant-tables --user="$(id -un)" \
+      --log-error="${WORK_DIR}/log/mariadb.err" &
+    PIDS+=($!)
+    for _ in $(seq 1 60); do
+      mariadb-admin --no-defaults --socket="${DB_SOCKET}" ping >/dev/null 2>&1 && break
+      sleep 0.5
+    done
+    mariadb --no-defaults --socket="${DB_SOCKET}" -e "CREATE DATABASE mediathek_1"
+    mariadb --no-defaults --socket="${DB_SOCKET}" mediathek_1 < "${WORK_DIR}/video.sql"
+    export MT_API_DB_BACKEND=mariadb MT_API_DB_HOST=127.0.0.1 MT_API_DB_PORT="${DB_PORT}" MT_API_DB_NAME=mediathek_1
+    ;;
+esac
+
+# --- request mix ---------------------------------------------------------------
+
+urlencode() {
+  local LC_ALL=C s="$1" out="" c i
+  for ((i = 0; i < ${#s}; i++)); do
+    c="${s:i:1}"
+    case "${c}" in
+      [a-zA-Z0-9.~_-]) out+="${c}" ;;
+      *) printf -v c '%%%02X' "'${c}"; out+="${c}" ;;
+    esac
+  done
+  printf '%s' "${out}"
+}
+
+run_cgi() {
+  local query="$1" body="${2:-}"
+  if [[ -n "${body}" ]]; then
+    printf '%s' "${body}" | QUERY_STRING="${query}" REQUEST_METHOD=POST CONTENT_LENGTH="${#body}" \
+      CONTENT_TYPE=application/x-www-form-urlencoded SERVER_NAME=localhost REMOTE_ADDR=127.0.0.1 "${BINARY}"
+  else
+    QUERY_STRING="${query}" REQUEST_METHOD=GET SERVER_NAME=localhost REMOTE_ADDR=127.0.0.1 "${BINARY}" </dev/null
+  fi
+}
+
+list_query() {
+  printf '{"software":"Neutrino Mediathek","vMajor":0,"vMinor":4,"isBeta":false,"vBeta":0,"mode":5,"data":{"channel":"%s","timeMode":1,"epoch":%s,"duration":%s,"limit":%s,"start":%s,"refTime":0}}' "$@"
+}
+
+# The requests go once through the CGI binary, which writes them to its
+# request log; the log is what mt-api-replay plays back.
+log "Recording the request mix."
+CHANNELS=()
+while IFS= read -r ch; do
+  CHANNELS+=("${ch}")
+done < <(run_cgi "mode=api&sub=listChannels" | grep -o '"channel":"[^"]*","count":[0-9]*' |
+  sort -t: -k3 -nr | head -n 8 | sed 's/^"channel":"\([^"]*\)".*/\1/')
+if [[ ${#CHANNELS[@]} -eq 0 ]]; then
+  echo "The backend returned no channels, see ${WORK_DIR}/log." >&2
+  KEEP=1
+  exit 1
+fi
+
+for _ in 1 2 3 4; do
+  run_cgi "mode=api&sub=info" >/dev/null
+done
+run_cgi "mode=api&sub=listChannels" >/dev/null
+run_cgi "mode=api&sub=listLivestream" >/dev/null
+for ch in "${CHANNELS[@]}"; do
+  for epoch in 1 7 30; do
+    run_cgi "mode=api" "data1=$(urlencode "$(list_query "${ch}" "${epoch}" 0 50 0)")" >/dev/null
+  done
+  run_cgi "mode=api" "data1=$(urlencode "$(list_query "${ch}" 7 0 50 50)")" >/dev/null
+  run_cgi "mode=api" "data1=$(urlencode "$(list_query "${ch}" -1 600 200 0)")" >/dev/null
+done
+
+REQUEST_LOG="${WORK_DIR}/requests.log"
+cp "${WORK_DIR}/log/mt-api.requests.log" "${REQUEST_LOG}"
+
+# --- modes -----------------------------------------------------------------------
+
+wait_for() {
+  local path="$1"
+  for _ in $(seq 1 50); do
+    [[ -e "${path}" ]] && return 0
+    sleep 0.1
+  done
+  return 1
+}
+
+wait_for_port() {
+  local port="$1"
+  for _ in $(seq 1 50); do
+    (exec 3<>"/dev/tcp/127.0.0.1/${port}") 2>/dev/null && return 0
+    sleep 0.1
+  done
+  return 1
+}
+
+REPLAY=("${BUILD_DIR}/mt-api-replay" -c "${CONCURRENCY}" -n "${REQUESTS}" --path /mt-api)
+RESULTS=()
+
+run_mode() {
+  local mode="$1"
+  shift
+  log "Mode ${mode}: ${REQUESTS} requests, concurrency ${CONCURRENCY}."
+  "${REPLAY[@]}" "$@" "${REQUEST_LOG}" | tee "${WORK_DIR}/result-${mode}.txt"
+  RESULTS+=("${mode}")
+}
+
+for mode in ${MODES}; do
+  case "${mode}" in
+    cgi)
+      run_mode cgi --cgi "${BINARY}"
+      ;;
+    cgi-via-fcgiwrap)
+      if ! command -v spawn-fcgi >/dev/null || ! command -v fcgiwrap >/dev/null; then
+        log "Mode cgi-via-fcgiwrap skipped, spawn-fcgi or fcgiwrap not found."
+        continue
+      fi
+      FCGI_SOCKET="${WORK_DIR}/fcgi.sock"
+      spawn-fcgi -n -s "${FCGI_SOCKET}" -- "$(command -v fcgiwrap)" -c "${CONCURRENCY}" >/dev/null 2>&1 &
+      PIDS+=($!)
+      wait_for "${FCGI_SOCKET}"
+      run_mode cgi-via-fcgiwrap --fcgi "unix:${FCGI_SOCKET}"
+      ;;
+    http)
+      if ! command -v lighttpd >/dev/null; then
+        log "Mode http skipped, lighttpd not found."
+        continue
+      fi
+      HTTP_PORT=$((PORT_BASE + 1))
+      cat > "${WORK_DIR}/lighttpd.conf" <<EOF
+server.modules = ( "mod_setenv", "mod_cgi" )
+server.document-root = "${WWW_DIR}"
+server.port = ${HTTP_PORT}
+server.bind = "127.0.0.1"
+server.errorlog = "${WORK_DIR}/log/lighttpd.err"
+cgi.assign = ( "/mt-api" => "" )
+setenv.add-environment = (
+  "MT_API_DB_BACKEND" => "${MT_API_DB_BACKEND}",
+  "MT_API_DB_FILE" => "${MT_API_DB_FILE:-}",
+  "MT_API_DB_HOST" => "${MT_API_DB_HOST:-}",
+  "MT_API_DB_PORT" => "${MT_API_DB_PORT:-}",
+  "MT_API_DB_NAME" => "${MT_API_DB_NAME:-}",
+  "MT_API_SLOW_QUERY_MS" => "${MT_API_SLOW_QUERY_MS}",
+  "MT_API_RATE_LIMIT" => "${MT_API_RATE_LIMIT}",
+  "MT_API_MAX_DB_REQUESTS" => "${MT_API_MAX_DB_REQUESTS}"
+)
+EOF
+      lighttpd -D -f "${WORK_DIR}/lighttpd.conf" &
+      PIDS+=($!)
+      wait_for_port "${HTTP_PORT}"
+      run_mode http --http "127.0.0.1:${HTTP_PORT}"
+      ;;
+    *)
+      log "Unknown mode '${mode}' skipped."
+      ;;
+  esac
+done
+
+# --- summary ---------------------------------------------------------------------
+
+echo
+printf '%-16s %12s %10s %10s %10s %8s\n' mode "req/s" "p50 ms" "p99 ms" "max ms" errors
+for mode in "${RESULTS[@]}"; do
+  awk -v mode="${mode}" '
+    /^requests/   { errors = $4; sub(/,/, "", errors) }
+    /^throughput/ { rps = $2 }
+    /^latency/    { for (i = 2; i < NF; i++) { if ($i == "p50") p50 = $(i + 1); if ($i == "p99") p99 = $(i + 1); if ($i == "max") max = $(i + 1) } }
+    END           { printf "%-16s %12s %10s %10s %10s %8s\n", mode, rps, p50, p99, max, errors }
+  ' "${WORK_DIR}/result-${mode}.txt"
+done
+echo "All modes start one mt-api CGI process per request; no native FastCGI/server mode exists."
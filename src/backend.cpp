@@ -0,0 +1,203 @@
+
+#include <sys/types.h>
+#include <time.h>
+
+#include <iostream>
+#include <string>
+
+#include "common/helpers.h"
+#include "mt-api.h"
+#include "json.h"
+#include "backend.h"
+#include "sql.h"
+#include "sqlite.h"
+#include "template.h"
+#include "timing.h"
+#include "reqlog.h"
+
+extern CMtApi*		g_mainInstance;
+extern string		g_logRoot;
+extern bool		g_debugMode;
+extern string		g_msgBoxText;
+
+CDbBackend::CDbBackend()
+{
+	resultCount	= 0;
+	rowCount	= 0;
+	connectTried	= false;
+
+	/* MT_API_SLOW_QUERY_MS: threshold for the slow query log, 0 logs all, < 0 disables it */
+	const char* slowEnv = getenv("MT_API_SLOW_QUERY_MS");
+	slowQueryMs	= (slowEnv && *slowEnv) ? atoi(slowEnv) : 1000;
+	const char* deadlineEnv = getenv("MT_API_DEADLINE_MS");
+	deadlineMs	= (deadlineEnv && *deadlineEnv) ? atoi(deadlineEnv) : 5000;
+}
+
+CDbBackend* CDbBackend::create()
+{
+	const char* typeEnv = getenv("MT_API_DB_BACKEND");
+	const char* fileEnv = getenv("MT_API_DB_FILE");
+	string type = (typeEnv && *typeEnv) ? str_tolower(typeEnv) : "mariadb";
+	string file = (fileEnv && *fileEnv) ? fileEnv : "";
+
+	if (strEqual(type, "sqlite"))
+		return new CSqliteDb(CSqliteDb::sourceFile, file);
+	if (strEqual(type, "catalog"))
+		return new CSqliteDb(CSqliteDb::sourceCatalog, file);
+	return new CSql();
+}
+
+/* The connection is opened by the first query, routes without one never connect */
+bool CDbBackend::ready()
+{
+	if (timeLeftMs() <= 0) {
+		g_msgBoxText = "<span style='color: OrangeRed'>Request deadline exceeded.\n<br /></span>";
+		return false;
+	}
+	if (!connectTried) {
+		connectTried = true;
+		CStageScope stageScope(g_mainInstance->timer, CStageTimer::stageConnect);
+		connect();
+	}
+	return isConnected();
+}
+
+/* ms left until the request deadline, INT64_MAX without one */
+int64_t CDbBackend::timeLeftMs()
+{
+	if (deadlineMs <= 0)
+		return INT64_MAX;
+	return deadlineMs - g_mainInstance->timer->elapsed() / 1000000;
+}
+
+/*
+ * Time window of a listVideos query: rangeBetween selects
+ * toTime < date_unix < fromTime, rangeBefore date_unix < fromTime.
+ */
+int CDbBackend::listVideoRange(cmdListVideo_t* clv, listVideoHead_t* lvh, time_t* fromTime, time_t* toTime)
+{
+	time_t now = (clv->refTime == 0) ? time(0) : clv->refTime;
+	*fromTime = now;
+	*toTime   = 0;
+
+	g_mainInstance->cjson->resetListVideoHeadStruct(lvh);
+	lvh->refTime	= now;
+
+	time_t epoch = clv->epoch;
+	/* (clv->epoch < 0) => all data */
+	if (epoch == 0)
+		epoch = 1;
+
+	if (epoch > 0) {
+		epoch = epoch * 3600 * 24;
+		*toTime = now - epoch;
+		if (clv->timeMode == timeMode_future)
+			*fromTime += epoch;
+		return rangeBetween;
+	}
+	return (clv->timeMode != timeMode_future) ? rangeBefore : rangeNone;
+}
+
+void CDbBackend::setListVideoHead(cmdListVideo_t* clv, listVideoHead_t* lvh, int rowsCount, int total)
+{
+	lvh->start	= clv->start;
+	lvh->end	= clv->start + rowsCount - 1;
+	lvh->rows	= rowsCount;
+	lvh->total	= total;
+}
+
+string CDbBackend::formatSql(string data, int id, string tagBefore, string tagAfter)
+{
+	string html = g_mainInstance->templates()->render("sql-format.html", { { "SQL_DATA", base64encode(data) }, { "ID", to_string(id) } });
+	return tagBefore + html + tagAfter;
+}
+
+/*
+ * Queries slower than MT_API_SLOW_QUERY_MS go to the slow query log with
+ * parameters, timing, row count and EXPLAIN; the debug page shows the
+ * same data for every query next to the formatted SQL.
+ */
+void CDbBackend::checkQuery(string sql, int id, int64_t durationNs, uint64_t rows, cmdListVideo_t* clv)
+{
+	bool slow = ((slowQueryMs >= 0) && (durationNs >= static_cast<int64_t>(slowQueryMs) * 1000000LL));
+	if ((!slow && !g_debugMode) || !isConnected())
+		return;
+
+	string params = "";
+	if (clv != NULL) {
+		params += "channel=" + clv->channel;
+		params += " timeMode=" + to_string(clv->timeMode);
+		params += " epoch=" + to_string(clv->epoch);
+		params += " duration=" + to_string(clv->duration);
+		params += " limit=" + to_string(clv->limit);
+		params += " start=" + to_string(clv->start);
+		params += " refTime=" + to_string(static_cast<long long>(clv->refTime));
+	}
+	string explain = explainQuery(sql);
+	char ms[32];
+	snprintf(ms, sizeof(ms), "%.3f", static_cast<double>(durationNs) / 1000000.0);
+
+	if (slow) {
+		string explainLine = str_replace("\n", "; ", explain);
+		CRequestLog slowLog;
+		slowLog.setFile(g_logRoot + "/mt-api.slow.log");
+		slowLog.beginEvent("slow-query");
+		slowLog.addField("id", g_mainInstance->timer->getRequestId(), false);
+		slowLog.addField("ms", ms, false);
+		slowLog.addField("rows", static_cast<long long>(rows));
+		slowLog.addField("params", str_replace("\"", "'", params));
+		slowLog.addField("sql", str_replace("\"", "'", sql));
+		slowLog.addField("explain", str_replace("\"", "'", explainLine));
+		slowLog.endEvent();
+		slowLog.flush();
+	}
+
+	if (g_debugMode) {
+		string info = "";
+		info += string("Duration: ") + ms + " ms, rows: " + to_string(static_cast<unsigned long long>(rows)) + ((slow) ? " (slow)" : "") + "\n";
+		if (!params.empty())
+			info += "Parameters: " + params + "\n";
+		info += "EXPLAIN:\n" + explain;
+		info = str_replace("&", "&amp;", info);
+		info = str_replace("<", "&lt;", info);
+		info = str_replace(">", "&gt;", info);
+
+		g_mainInstance->htmlOut << g_mainInstance->templates()->render("sql-info.html", { { "INFO_DATA", base64encode(info) }, { "ID", to_string(id) } }) << endl;
+	}
+}
+
+/* Without a streaming cursor: fetch the page, then hand out the rows */
+bool CDbBackend::sqlStreamVideo(cmdListVideo_t* clv, listVideoHead_t* lvh, exportVideoCallback_t callback)
+{
+	vector<listVideo_t> lv;
+	if (!sqlListVideo(clv, lvh, lv))
+		return false;
+
+	for (size_t i = 0; i < lv.size(); i++) {
+		if (!callback(&lv[i]))
+			return false;
+	}
+	return true;
+}
+
+/* Without multi-statement support the sub-requests run one after another */
+bool CDbBackend::sqlBatch(vector<batchRequest_t>& br)
+{
+	bool ret = true;
+	for (size_t i = 0; (i < br.size()) && ret; i++) {
+		batchRequest_t* r = &br[i];
+		if (!r->error.empty())
+			continue;
+		if (r->queryMode == queryMode_Info)
+			ret = sqlGetProgInfo(&r->pi);
+		else if (r->queryMode == queryMode_listLivestreams)
+			ret = sqlListLiveStreams(r->ls);
+		else if (r->queryMode == queryMode_listChannels)
+			ret = sqlListChannels(r->ch);
+		else if (r->queryMode == queryMode_listVideos) {
+			ret = sqlListVideo(&r->clv, &r->lvh, r->lv);
+			r->total = r->lvh.total;
+		}
+	}
+	return ret;
+}
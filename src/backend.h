@@ -0,0 +1,74 @@
+
+#ifndef __BACKEND_H__
+#define __BACKEND_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "types.h"
+
+using namespace std;
+
+typedef function<bool(listVideo_t* lv)> exportVideoCallback_t;
+
+/*
+ * Storage backend of the api. CSql talks to a MariaDB server, CSqliteDb
+ * serves a read-only SQLite file or a catalog dump loaded into memory.
+ * MT_API_DB_BACKEND selects the backend (mariadb, sqlite, catalog),
+ * MT_API_DB_FILE names the file of the local backends.
+ * MT_API_DEADLINE_MS bounds the time a request may spend on the database,
+ * counted from the start of the request (default 5000, 0: none). Routes
+ * that need longer change it with setDeadline() before the first query.
+ */
+class CDbBackend
+{
+	protected:
+		enum {
+			rangeNone,
+			rangeBefore,
+			rangeBetween
+		};
+
+		int resultCount;
+		uint64_t rowCount;
+		int slowQueryMs;
+		int deadlineMs;
+		bool connectTried;
+
+		int listVideoRange(cmdListVideo_t* clv, listVideoHead_t* lvh, time_t* fromTime, time_t* toTime);
+		void setListVideoHead(cmdListVideo_t* clv, listVideoHead_t* lvh, int rowsCount, int total);
+		string formatSql(string data, int id, string tagBefore="", string tagAfter="");
+		virtual string explainQuery(string sql) = 0;
+		void checkQuery(string sql, int id, int64_t durationNs, uint64_t rows, cmdListVideo_t* clv);
+
+	public:
+		CDbBackend();
+		virtual ~CDbBackend() {};
+
+		static CDbBackend* create();
+
+		virtual bool connect() = 0;
+		virtual bool isConnected() = 0;
+		bool ready();
+		int64_t timeLeftMs();
+		void setDeadline(int ms) { deadlineMs = ms; };
+		uint64_t getRowCount() { return rowCount; };
+		virtual bool sqlListVideo(cmdListVideo_t* clv, listVideoHead_t* lvh, vector<listVideo_t>& lv) = 0;
+		virtual bool sqlGetProgInfo(progInfo_t* pi) = 0;
+		virtual bool sqlListLiveStreams(vector<livestreams_t>& ls) = 0;
+		virtual bool sqlListChannels(vector<channels_t>& ch) = 0;
+		virtual bool sqlExportVideos(exportVideoCallback_t callback) = 0;
+		virtual bool sqlStreamVideo(cmdListVideo_t* clv, listVideoHead_t* lvh, exportVideoCallback_t callback);
+		virtual bool sqlBatch(vector<batchRequest_t>& br);
+};
+
+
+#endif // __BACKEND_H__
@@ -0,0 +1,732 @@
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <climits>
+#include <algorithm>
+#include <string>
+
+#include "common/helpers.h"
+#include "mt-api.h"
+#include "catalog.h"
+#include "json.h"
+#include "net.h"
+#include "output.h"
+#include "metrics.h"
+#include "backend.h"
+#include "limiter.h"
+
+extern CMtApi*		g_mainInstance;
+extern string		g_cacheRoot;
+extern string		g_jsonError;
+
+static const char* dumpMagic	= "MTCD";
+static const char* patchMagic	= "MTCP";
+
+typedef vector<pair<uint64_t, uint32_t> > hashSet_t;
+
+static void putVarint(string& out, uint64_t val)
+{
+	while (val >= 0x80) {
+		out += static_cast<char>((val & 0x7F) | 0x80);
+		val >>= 7;
+	}
+	out += static_cast<char>(val);
+}
+
+static void putInt(string& out, int64_t val)
+{
+	putVarint(out, (static_cast<uint64_t>(val) << 1) ^ static_cast<uint64_t>(val >> 63));
+}
+
+static void putString(string& out, const string& str)
+{
+	putVarint(out, str.length());
+	out += str;
+}
+
+static void putUrl(string& out, const string& base, const string& url)
+{
+	size_t len = min(base.length(), url.length());
+	size_t prefix = 0;
+	while ((prefix < len) && (base[prefix] == url[prefix]))
+		prefix++;
+	putVarint(out, prefix);
+	putString(out, url.substr(prefix));
+}
+
+static bool getVarint(const string& in, size_t* pos, uint64_t* val)
+{
+	uint64_t ret = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (*pos >= in.length())
+			return false;
+		uint8_t c = static_cast<uint8_t>(in[(*pos)++]);
+		ret |= static_cast<uint64_t>(c & 0x7F) << shift;
+		if ((c & 0x80) == 0) {
+			*val = ret;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool getInt(const string& in, size_t* pos, int64_t* val)
+{
+	uint64_t tmp;
+	if (!getVarint(in, pos, &tmp))
+		return false;
+	*val = static_cast<int64_t>(tmp >> 1) ^ -static_cast<int64_t>(tmp & 1);
+	return true;
+}
+
+static bool getString(const string& in, size_t* pos, string* str)
+{
+	uint64_t len;
+	if (!getVarint(in, pos, &len) || (len > (in.length() - *pos)))
+		return false;
+	*str = in.substr(*pos, len);
+	*pos += len;
+	return true;
+}
+
+static bool getUrl(const string& in, size_t* pos, const string& base, string* url)
+{
+	uint64_t prefix;
+	string suffix;
+	if (!getVarint(in, pos, &prefix) || (prefix > base.length()) || !getString(in, pos, &suffix))
+		return false;
+	*url = base.substr(0, prefix) + suffix;
+	return true;
+}
+
+/* ---------------------------------------------------------------------- */
+
+CCatalogWriter::CCatalogWriter()
+{
+	gz = NULL;
+}
+
+CCatalogWriter::~CCatalogWriter()
+{
+	if (gz != NULL)
+		gzclose(gz);
+}
+
+bool CCatalogWriter::open(string file)
+{
+	gz = gzopen(file.c_str(), "wb9");
+	return (gz != NULL);
+}
+
+bool CCatalogWriter::write(const string& data)
+{
+	if ((gz == NULL) || data.empty())
+		return (gz != NULL);
+	return (gzwrite(gz, data.data(), data.length()) == static_cast<int>(data.length()));
+}
+
+bool CCatalogWriter::writeVarint(uint64_t val)
+{
+	buf.clear();
+	putVarint(buf, val);
+	return write(buf);
+}
+
+bool CCatalogWriter::writeRecord(const string& record)
+{
+	return (writeVarint(record.length()) && write(record));
+}
+
+/* dump header and trailer, the records go in between */
+bool CCatalogWriter::beginDump(int64_t ver)
+{
+	string head = dumpMagic;
+	head += static_cast<char>(CCatalog::formatVersion);
+	return (write(head) && writeVarint(ver));
+}
+
+bool CCatalogWriter::endDump(uint64_t count)
+{
+	return (writeVarint(0) && writeVarint(count));
+}
+
+bool CCatalogWriter::close()
+{
+	if (gz == NULL)
+		return false;
+	int ret = gzclose(gz);
+	gz = NULL;
+	return (ret == Z_OK);
+}
+
+/* ---------------------------------------------------------------------- */
+
+CCatalogReader::CCatalogReader()
+{
+	gz = NULL;
+}
+
+CCatalogReader::~CCatalogReader()
+{
+	close();
+}
+
+bool CCatalogReader::open(string file)
+{
+	gz = gzopen(file.c_str(), "rb");
+	if (gz != NULL)
+		gzbuffer(gz, 128*1024);
+	return (gz != NULL);
+}
+
+bool CCatalogReader::read(void* data, size_t len)
+{
+	if (gz == NULL)
+		return false;
+	if (len == 0)
+		return true;
+	return (gzread(gz, data, len) == static_cast<int>(len));
+}
+
+bool CCatalogReader::readVarint(uint64_t* val)
+{
+	if (gz == NULL)
+		return false;
+
+	uint64_t ret = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		int c = gzgetc(gz);
+		if (c < 0)
+			return false;
+		ret |= static_cast<uint64_t>(c & 0x7F) << shift;
+		if ((c & 0x80) == 0) {
+			*val = ret;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool CCatalogReader::readRecord(string& record, bool* end)
+{
+	uint64_t len;
+	if (!readVarint(&len))
+		return false;
+	*end = (len == 0);
+	record.resize(len);
+	return (len == 0) || read(&record[0], len);
+}
+
+void CCatalogReader::close()
+{
+	if (gz != NULL)
+		gzclose(gz);
+	gz = NULL;
+}
+
+/* ---------------------------------------------------------------------- */
+
+static bool readHeader(CCatalogReader& reader, const char* magic, int64_t* ver)
+{
+	char head[5];
+	uint64_t tmp;
+	if (!reader.read(head, sizeof(head)) || (memcmp(head, magic, 4) != 0) ||
+	    (head[4] != CCatalog::formatVersion) || !reader.readVarint(&tmp))
+		return false;
+	*ver = static_cast<int64_t>(tmp);
+	return true;
+}
+
+bool CCatalogReader::beginDump(int64_t* ver)
+{
+	return readHeader(*this, dumpMagic, ver);
+}
+
+/* Hash all records of a dump file in file order. */
+static bool hashDump(string file, vector<uint64_t>& hashes, int64_t* ver)
+{
+	CCatalogReader reader;
+	if (!reader.open(file) || !reader.beginDump(ver))
+		return false;
+
+	string record;
+	bool end = false;
+	while (reader.readRecord(record, &end) && !end)
+		hashes.push_back(CCatalog::hashRecord(record));
+
+	uint64_t count;
+	return (end && reader.readVarint(&count) && (count == hashes.size()));
+}
+
+static void makeHashSet(const vector<uint64_t>& hashes, hashSet_t& set)
+{
+	vector<uint64_t> sorted(hashes);
+	sort(sorted.begin(), sorted.end());
+	for (size_t i = 0; i < sorted.size(); i++) {
+		if (!set.empty() && (set.back().first == sorted[i]))
+			set.back().second++;
+		else
+			set.push_back(make_pair(sorted[i], 1));
+	}
+}
+
+/* Remove one occurrence of hash from set, false if there is none left. */
+static bool takeHash(hashSet_t& set, uint64_t hash)
+{
+	hashSet_t::iterator it = lower_bound(set.begin(), set.end(), make_pair(hash, static_cast<uint32_t>(0)));
+	if ((it == set.end()) || (it->first != hash) || (it->second == 0))
+		return false;
+	it->second--;
+	return true;
+}
+
+CCatalog::CCatalog()
+{
+	catalogDir	= g_cacheRoot + "/catalog";
+	version		= 0;
+	records		= 0;
+	busy		= false;
+}
+
+CCatalog::~CCatalog()
+{
+}
+
+string CCatalog::encodeRecord(const listVideo_t* lv)
+{
+	string ret;
+	ret.reserve(lv->description.length() + lv->url.length() + 256);
+	putString(ret, lv->channel);
+	putString(ret, lv->theme);
+	putString(ret, lv->title);
+	putString(ret, lv->description);
+	putString(ret, lv->subtitle);
+	putString(ret, lv->url);
+	putUrl(ret, lv->url, lv->url_small);
+	putUrl(ret, lv->url, lv->url_hd);
+	putInt(ret, lv->date_unix);
+	putInt(ret, lv->duration);
+	putString(ret, lv->geo);
+	putInt(ret, lv->parse_m3u8);
+	return ret;
+}
+
+bool CCatalog::decodeRecord(const string& record, listVideo_t* lv)
+{
+	size_t pos = 0;
+	int64_t date_unix, duration, parse_m3u8;
+	if (!getString(record, &pos, &lv->channel) ||
+	    !getString(record, &pos, &lv->theme) ||
+	    !getString(record, &pos, &lv->title) ||
+	    !getString(record, &pos, &lv->description) ||
+	    !getString(record, &pos, &lv->subtitle) ||
+	    !getString(record, &pos, &lv->url) ||
+	    !getUrl(record, &pos, lv->url, &lv->url_small) ||
+	    !getUrl(record, &pos, lv->url, &lv->url_hd) ||
+	    !getInt(record, &pos, &date_unix) ||
+	    !getInt(record, &pos, &duration) ||
+	    !getString(record, &pos, &lv->geo) ||
+	    !getInt(record, &pos, &parse_m3u8))
+		return false;
+	lv->date_unix	= static_cast<time_t>(date_unix);
+	lv->duration	= static_cast<int>(duration);
+	lv->parse_m3u8	= static_cast<int>(parse_m3u8);
+	return (pos == record.length());
+}
+
+uint64_t CCatalog::hashRecord(const string& record)
+{
+	/* FNV-1a */
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < record.length(); i++) {
+		hash ^= static_cast<uint8_t>(record[i]);
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+string CCatalog::dumpFile(int64_t ver)
+{
+	return catalogDir + "/catalog-" + to_string(ver) + ".mtc.gz";
+}
+
+string CCatalog::patchFile(int64_t from, int64_t to)
+{
+	return catalogDir + "/patch-" + to_string(from) + "-" + to_string(to) + ".mtp.gz";
+}
+
+bool CCatalog::loadIndex()
+{
+	version = 0;
+	records = 0;
+	patches.clear();
+
+	string file = catalogDir + "/catalog.json";
+	if (!file_exists(file.c_str()))
+		return false;
+
+	Json::Value root;
+	if (!parseJsonFromFile(file, &root, NULL) || !root.isObject())
+		return false;
+	/* Files of an older format are rebuilt, their patches are not offered. */
+	if (root.get("format", 0).asInt() != formatVersion)
+		return false;
+
+	version = root.get("version", 0).asInt64();
+	records = root.get("records", 0).asInt();
+	Json::Value p = root["patches"];
+	for (Json::ArrayIndex i = 0; p.isArray() && (i < p.size()); i++)
+		patches.push_back(make_pair(p[i].get("from", 0).asInt64(), p[i].get("to", 0).asInt64()));
+
+	return true;
+}
+
+bool CCatalog::saveIndex()
+{
+	Json::Value root;
+	root["format"]	= formatVersion;
+	root["version"] = static_cast<Json::Int64>(version);
+	root["records"] = records;
+	Json::Value p(Json::arrayValue);
+	for (size_t i = 0; i < patches.size(); i++) {
+		Json::Value entry;
+		entry["from"]	= static_cast<Json::Int64>(patches[i].first);
+		entry["to"]	= static_cast<Json::Int64>(patches[i].second);
+		p.append(entry);
+	}
+	root["patches"] = p;
+
+	string file = catalogDir + "/catalog.json";
+	string tmpFile = file + ".tmp";
+	ofstream out(tmpFile.c_str(), ios::trunc);
+	out << writeJson2String(root, "  ");
+	out.close();
+	if (!out.good() || (rename(tmpFile.c_str(), file.c_str()) != 0)) {
+		unlink(tmpFile.c_str());
+		return false;
+	}
+	return true;
+}
+
+/* a slot under MT_API_MAX_DB_REQUESTS for the database work of update() */
+bool CCatalog::acquireDb()
+{
+	CLimiter* limiter = g_mainInstance->limiter;
+	if ((limiter == NULL) || limiter->acquireDb())
+		return true;
+	busy = true;
+	g_jsonError = "Server busy, please retry later.";
+	return false;
+}
+
+void CCatalog::releaseDb()
+{
+	if (g_mainInstance->limiter != NULL)
+		g_mainInstance->limiter->releaseDb();
+}
+
+/*
+ * Brings the dump up to the version in the database. false with
+ * isBusy(): no database slot, or another process is building and there
+ * is no older dump to send meanwhile.
+ */
+bool CCatalog::update()
+{
+	progInfo_t pi;
+	g_mainInstance->cjson->resetProgInfoStruct(&pi);
+	if (!acquireDb())
+		return false;
+	bool ok = g_mainInstance->db()->sqlGetProgInfo(&pi);
+	releaseDb();
+	if (!ok) {
+		g_jsonError = "Database not available.";
+		return false;
+	}
+
+	/* Each import writes a new movie list date into the version table. */
+	int64_t current = (pi.mvdate != 0) ? pi.mvdate : pi.vdate;
+	if (current <= 0) {
+		g_jsonError = "No catalog version available.";
+		return false;
+	}
+
+	loadIndex();
+	bool hit = ((current == version) && file_exists(dumpFile(version).c_str()));
+	g_mainInstance->metrics->countCache(CMetrics::cacheCatalog, hit);
+	if (hit)
+		return true;
+
+	mkdir(g_cacheRoot.c_str(), 0755);
+	mkdir(catalogDir.c_str(), 0755);
+	string lockFile = catalogDir + "/catalog.lock";
+	int lockFd = open(lockFile.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+	if (lockFd < 0) {
+		g_jsonError = "Catalog directory not writable.";
+		return false;
+	}
+
+	/*
+	 * Only one process builds and holds a database slot for it. The
+	 * others do not wait for the lock (nor hold a slot meanwhile): they
+	 * send the previous dump, or are told to retry.
+	 */
+	int lockRet;
+	while (((lockRet = flock(lockFd, LOCK_EX | LOCK_NB)) != 0) && (errno == EINTR))
+		;
+	if (lockRet != 0) {
+		close(lockFd);
+		if ((version > 0) && file_exists(dumpFile(version).c_str()))
+			return true;
+		busy = true;
+		g_jsonError = "Catalog is being built, please retry later.";
+		return false;
+	}
+
+	bool ret = true;
+	loadIndex();
+	if ((current != version) || !file_exists(dumpFile(version).c_str())) {
+		ret = acquireDb();
+		if (ret) {
+			ret = build(current);
+			releaseDb();
+			if (!ret)
+				g_jsonError = "Error building catalog.";
+		}
+	}
+	close(lockFd);
+
+	return ret;
+}
+
+bool CCatalog::build(int64_t newVersion)
+{
+	string file = dumpFile(newVersion);
+	string tmpFile = file + ".tmp";
+
+	CCatalogWriter writer;
+	if (!writer.open(tmpFile))
+		return false;
+
+	bool ok = writer.beginDump(newVersion);
+
+	int count = 0;
+	ok = ok && g_mainInstance->db()->sqlExportVideos([&writer, &count](listVideo_t* lv) -> bool {
+		count++;
+		return writer.writeRecord(encodeRecord(lv));
+	});
+	ok = ok && writer.endDump(count);
+	ok = writer.close() && ok;
+	if (!ok || (rename(tmpFile.c_str(), file.c_str()) != 0)) {
+		unlink(tmpFile.c_str());
+		return false;
+	}
+
+	string oldFile = dumpFile(version);
+	if ((version > 0) && (version < newVersion) && file_exists(oldFile.c_str())) {
+		if (buildPatch(oldFile, file, patchFile(version, newVersion)))
+			patches.push_back(make_pair(version, newVersion));
+	}
+
+	version = newVersion;
+	records = count;
+	prune();
+	return saveIndex();
+}
+
+bool CCatalog::buildPatch(string oldFile, string newFile, string file)
+{
+	vector<uint64_t> oldHashes, newHashes;
+	int64_t from, to;
+	if (!hashDump(oldFile, oldHashes, &from) || !hashDump(newFile, newHashes, &to))
+		return false;
+
+	hashSet_t oldSet, newSet;
+	makeHashSet(oldHashes, oldSet);
+	makeHashSet(newHashes, newSet);
+
+	vector<uint64_t> drops;
+	for (size_t i = 0; i < oldHashes.size(); i++) {
+		if (!takeHash(newSet, oldHashes[i]))
+			drops.push_back(oldHashes[i]);
+	}
+	sort(drops.begin(), drops.end());
+	vector<bool> adds(newHashes.size(), false);
+	uint64_t addCount = 0;
+	for (size_t i = 0; i < newHashes.size(); i++) {
+		if (!takeHash(oldSet, newHashes[i])) {
+			adds[i] = true;
+			addCount++;
+		}
+	}
+
+	string tmpFile = file + ".tmp";
+	CCatalogWriter writer;
+	if (!writer.open(tmpFile))
+		return false;
+
+	string head = patchMagic;
+	head += static_cast<char>(formatVersion);
+	bool ok = writer.write(head) && writer.writeVarint(from) && writer.writeVarint(to) &&
+		  writer.writeVarint(newHashes.size()) && writer.writeVarint(drops.size());
+	uint64_t last = 0;
+	for (size_t i = 0; ok && (i < drops.size()); i++) {
+		ok = writer.writeVarint(drops[i] - last);
+		last = drops[i];
+	}
+	ok = ok && writer.writeVarint(addCount);
+
+	CCatalogReader reader;
+	int64_t ver;
+	ok = ok && reader.open(newFile) && reader.beginDump(&ver);
+	string record;
+	bool end = false;
+	for (size_t i = 0; ok && (i < adds.size()); i++) {
+		ok = reader.readRecord(record, &end) && !end;
+		if (ok && adds[i])
+			ok = writer.writeRecord(record);
+	}
+	reader.close();
+
+	ok = writer.close() && ok;
+	if (!ok || (rename(tmpFile.c_str(), file.c_str()) != 0)) {
+		unlink(tmpFile.c_str());
+		return false;
+	}
+	return true;
+}
+
+/* records must hold version *ver, on success they hold the patch target version. */
+bool CCatalog::applyPatch(string file, vector<string>& records, int64_t* ver)
+{
+	CCatalogReader reader;
+	int64_t from;
+	uint64_t to, recordCount, dropCount, addCount;
+	if (!reader.open(file) || !readHeader(reader, patchMagic, &from) || (from != *ver) ||
+	    !reader.readVarint(&to) || !reader.readVarint(&recordCount) || !reader.readVarint(&dropCount))
+		return false;
+
+	vector<uint64_t> drops;
+	uint64_t hash = 0, delta;
+	for (uint64_t i = 0; i < dropCount; i++) {
+		if (!reader.readVarint(&delta))
+			return false;
+		hash += delta;
+		drops.push_back(hash);
+	}
+	hashSet_t dropSet;
+	makeHashSet(drops, dropSet);
+
+	uint64_t dropped = 0;
+	size_t keep = 0;
+	for (size_t i = 0; i < records.size(); i++) {
+		if (takeHash(dropSet, hashRecord(records[i])))
+			dropped++;
+		else if (keep++ != i)
+			records[keep - 1].swap(records[i]);
+	}
+	/* A drop without its record: the list is not the patch's base version. */
+	if (dropped != dropCount)
+		return false;
+	records.resize(keep);
+
+	if (!reader.readVarint(&addCount))
+		return false;
+	string record;
+	bool end = false;
+	for (uint64_t i = 0; i < addCount; i++) {
+		if (!reader.readRecord(record, &end) || end)
+			return false;
+		records.push_back(record);
+	}
+	if (records.size() != recordCount)
+		return false;
+
+	*ver = static_cast<int64_t>(to);
+	return true;
+}
+
+void CCatalog::prune()
+{
+	while (patches.size() > maxPatches) {
+		unlink(patchFile(patches.front().first, patches.front().second).c_str());
+		patches.erase(patches.begin());
+	}
+
+	/* Only the current dump is needed, older clients use the patches. */
+	string current = dumpFile(version);
+	current = getBaseName(current);
+	DIR* dir = opendir(catalogDir.c_str());
+	if (dir == NULL)
+		return;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL) {
+		string name = entry->d_name;
+		if ((name.find("catalog-") == 0) && (name != current))
+			unlink((catalogDir + "/" + name).c_str());
+	}
+	closedir(dir);
+}
+
+string CCatalog::catalogInfo2Json()
+{
+	Json::Value json;
+	json["error"] = 0;
+
+	Json::Value head;
+	head["format"]	= formatVersion;
+	head["version"]	= static_cast<Json::Int64>(version);
+	head["records"]	= records;
+	head["size"]	= static_cast<Json::Int64>(file_size(dumpFile(version).c_str()));
+	json["head"]	= head;
+
+	Json::Value entry(Json::arrayValue);
+	for (size_t i = 0; i < patches.size(); i++) {
+		Json::Value entryData;
+		entryData["from"]	= static_cast<Json::Int64>(patches[i].first);
+		entryData["to"]		= static_cast<Json::Int64>(patches[i].second);
+		entryData["size"]	= static_cast<Json::Int64>(file_size(patchFile(patches[i].first, patches[i].second).c_str()));
+		entry.append(entryData);
+	}
+	json["entry"] = entry;
+
+	return writeJson2String(json);
+}
+
+bool CCatalog::sendFile(string file, int64_t fileVersion)
+{
+	if (!file_exists(file.c_str())) {
+		g_jsonError = "Catalog file not available.";
+		return false;
+	}
+
+	COutput* output = g_mainInstance->cnet->output;
+	output->setContentType("application/octet-stream");
+	output->addHeader("X-Catalog-Version", to_string(fileVersion));
+	return output->sendFile(file);
+}
+
+bool CCatalog::sendCatalog()
+{
+	return sendFile(dumpFile(version), version);
+}
+
+bool CCatalog::sendPatch(int64_t from)
+{
+	for (size_t i = 0; i < patches.size(); i++) {
+		if (patches[i].first != from)
+			continue;
+		return sendFile(patchFile(patches[i].first, patches[i].second), patches[i].second);
+	}
+
+	g_jsonError = "No patch available for version " + to_string(from) + ".";
+	return false;
+}
@@ -0,0 +1,126 @@
+
+#ifndef __CATALOG_H__
+#define __CATALOG_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+using namespace std;
+
+/*
+ * Offline catalog export
+ *
+ * catalog-<version>.mtc.gz (gzip compressed):
+ *   "MTCD" u8:formatVersion varint:catalogVersion
+ *   { varint:len record[len] }...  varint:0  varint:recordCount
+ *
+ * patch-<from>-<to>.mtp.gz (gzip compressed):
+ *   "MTCP" u8:formatVersion varint:from varint:to varint:recordCount
+ *   varint:dropCount { varint:hashDelta }...
+ *   varint:addCount  { varint:len record[len] }...
+ *
+ * A record holds the fields delivered by listVideos. url_small and url_hd
+ * are stored as (varint:commonPrefixWithUrl, string:suffix). Strings are
+ * stored as varint:len bytes[len], numbers as zigzag varints.
+ *
+ * Records are identified by their 64 bit FNV-1a hash (hashRecord()). The
+ * drops are the hashes of the removed records in ascending order, each
+ * stored as the difference to the previous one. Equal records share a
+ * hash and are listed once per removed copy.
+ *
+ * Applying a patch: remove one record per drop hash from the old record
+ * list, then add the added records. Clients may keep the records in any
+ * order; applyPatch() is the reference implementation.
+ */
+
+class CCatalogWriter
+{
+	private:
+		gzFile gz;
+		string buf;
+
+	public:
+		CCatalogWriter();
+		~CCatalogWriter();
+
+		bool open(string file);
+		bool write(const string& data);
+		bool writeVarint(uint64_t val);
+		bool writeRecord(const string& record);
+		bool beginDump(int64_t ver);
+		bool endDump(uint64_t count);
+		bool close();
+};
+
+class CCatalogReader
+{
+	private:
+		gzFile gz;
+
+	public:
+		CCatalogReader();
+		~CCatalogReader();
+
+		bool open(string file);
+		bool read(void* data, size_t len);
+		bool readVarint(uint64_t* val);
+		bool readRecord(string& record, bool* end);
+		bool beginDump(int64_t* ver);
+		void close();
+};
+
+class CCatalog
+{
+	private:
+		string catalogDir;
+		int64_t version;
+		int records;
+		vector<pair<int64_t, int64_t> > patches;
+		bool busy;
+
+		bool acquireDb();
+		void releaseDb();
+		bool loadIndex();
+		bool saveIndex();
+		bool build(int64_t newVersion);
+		void prune();
+		bool sendFile(string file, int64_t fileVersion);
+
+	public:
+		enum {
+			formatVersion	= 2,
+			maxPatches	= 30
+		};
+
+		CCatalog();
+		~CCatalog();
+
+		static string encodeRecord(const listVideo_t* lv);
+		static bool decodeRecord(const string& record, listVideo_t* lv);
+		static uint64_t hashRecord(const string& record);
+		static bool buildPatch(string oldFile, string newFile, string file);
+		static bool applyPatch(string file, vector<string>& records, int64_t* ver);
+
+		string dumpFile(int64_t ver);
+		string patchFile(int64_t from, int64_t to);
+		int64_t getVersion() { return version; };
+
+		bool update();
+		bool isBusy() { return busy; };
+		string catalogInfo2Json();
+		bool sendCatalog();
+		bool sendPatch(int64_t from);
+};
+
+
+#endif // __CATALOG_H__
@@ -8,6 +8,8 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
 #include <fcntl.h>
 
 #include <fstream>
@@ -22,6 +24,7 @@
 #pragma GCC diagnostic pop
 
 #include "helpers.h"
+#include "filecache.h"
 
 time_t duration2time(string t)
 {
@@ -53,7 +56,7 @@ int duration2sec(string t, string forceFormat)
 		else if (len == 2)
 			format += "%S";
 		else {
-			cout << "[" << __func__ << ":" << __LINE__ << "] " << "Error parse time string \""<< t1 << "\"\n" << endl;
+			cerr << "[" << __func__ << ":" << __LINE__ << "] " << "Error parse time string \""<< t1 << "\"\n" << endl;
 			return 0;
 		}
 	}
@@ -61,7 +64,7 @@ int duration2sec(string t, string forceFormat)
 		format += forceFormat;
 	iss >> get_time(&tm, format.c_str());
 	if (iss.fail()) {
-		cout << "[" << __func__ << ":" << __LINE__ << "] " << "Error parse time string \""<< t2 << "\", format: \""<< format <<"\"\n" << endl;
+		cerr << "[" << __func__ << ":" << __LINE__ << "] " << "Error parse time string \""<< t2 << "\", format: \""<< format <<"\"\n" << endl;
 		return 0;
 	}
 	return static_cast<int>(mktime(&tm)) + 3600;
@@ -88,7 +91,7 @@ time_t str2time2(string format, string t)
 	istringstream iss(t);
 	iss >> get_time(&tm, format.c_str());
 	if (iss.fail()) {
-		cout << "[" << __func__ << ":" << __LINE__ << "] " << "Error parse time string \""<< t << "\", format: \""<< format <<"\"\n" << endl;
+		cerr << "[" << __func__ << ":" << __LINE__ << "] " << "Error parse time string \""<< t << "\", format: \""<< format <<"\"\n" << endl;
 		return 0;
 	}
 	tt = mktime(&tm);
@@ -162,11 +165,14 @@ string& str_replace(const string &search, const string &replace, string &text)
 		return text;
 
 	size_t searchLen = search.length();
+	size_t pos = 0;
 	while (1) {
-		size_t pos = text.find(search);
+		pos = text.find(search, pos);
 		if (pos == string::npos)
 			break;
 		text.replace(pos, searchLen, replace);
+		/* continue behind the replacement, it may contain search ("&" => "&amp;") */
+		pos += replace.length();
 	}
 	return text;
 }
@@ -351,27 +357,94 @@ string endlbr()
 	return ret.str();
 }
 
+/* one copy out of the mapping of g_fileCache */
 string readFile(string file)
 {
-	string ret_s;
-	ifstream tmpData(file.c_str(), ifstream::binary);
-	if (tmpData.is_open()) {
-		tmpData.seekg(0, tmpData.end);
-		int length = tmpData.tellg();
-		tmpData.seekg(0, tmpData.beg);
-		char* buffer = new char[length+1];
-		tmpData.read(buffer, length);
-		tmpData.close();
-		buffer[length] = '\0';
-		ret_s = (string)buffer;
-		delete [] buffer;
-	}
-	else {
-		cout << "Error read " << file << endl;
+	CFileCache::view_t view;
+	if (!g_fileCache.get(file, &view)) {
+		cerr << "Error read " << file << endl;
 		return "";
 	}
 
-	return ret_s;
+	return string(view.data, view.size);
+}
+
+static bool lockFile(int fd)
+{
+	int ret;
+	while (((ret = flock(fd, LOCK_EX)) != 0) && (errno == EINTR))
+		;
+	return (ret == 0);
+}
+
+/*
+ * Shared mapping of size bytes of file, for tables used by all CGI
+ * processes. The first two uint32_t of the data are magic and version.
+ * Returns with *fd locked (flock); *fresh: the mapping is new or was
+ * never initialized and has to be set up before the unlock. A file of another size or
+ * layout is never truncated, other processes may still map it (SIGBUS):
+ * a new file takes its place through rename() instead, and those
+ * processes keep using the old one.
+ */
+void* mapSharedFile(string file, size_t size, uint32_t magic, uint32_t version, int* fd, bool* fresh)
+{
+	for (int tries = 0; tries < 8; tries++) {
+		int f = open(file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0664);
+		if (f < 0)
+			return NULL;
+		struct stat st, pathSt;
+		if (!lockFile(f) || (fstat(f, &st) != 0)) {
+			close(f);
+			return NULL;
+		}
+		/* replaced while waiting for the lock: take the new one */
+		if ((stat(file.c_str(), &pathSt) != 0) || (pathSt.st_ino != st.st_ino) || (pathSt.st_dev != st.st_dev)) {
+			close(f);
+			continue;
+		}
+
+		/* a new file is not mapped by anyone yet */
+		bool isNew = (st.st_size == 0);
+		if (isNew && (ftruncate(f, size) != 0)) {
+			close(f);
+			return NULL;
+		}
+		if (isNew || (st.st_size == static_cast<off_t>(size))) {
+			void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, f, 0);
+			if (p == MAP_FAILED) {
+				close(f);
+				return NULL;
+			}
+			const uint32_t* header = static_cast<const uint32_t*>(p);
+			if (isNew || ((header[0] == 0) && (header[1] == 0)) || ((header[0] == magic) && (header[1] == version))) {
+				*fresh = (isNew || (header[0] == 0));
+				*fd = f;
+				return p;
+			}
+			munmap(p, size);
+		}
+
+		/* another layout: a new file, locked until the caller initialized it */
+		string tmpFile = file + "." + to_string(getpid()) + ".tmp";
+		int nf = open(tmpFile.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0664);
+		void* p = MAP_FAILED;
+		if ((nf >= 0) && lockFile(nf) && (ftruncate(nf, size) == 0))
+			p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, nf, 0);
+		if ((p == MAP_FAILED) || (rename(tmpFile.c_str(), file.c_str()) != 0)) {
+			if (p != MAP_FAILED)
+				munmap(p, size);
+			if (nf >= 0)
+				close(nf);
+			unlink(tmpFile.c_str());
+			close(f);
+			return NULL;
+		}
+		close(f);
+		*fresh = true;
+		*fd = nf;
+		return p;
+	}
+	return NULL;
 }
 
 bool parseJsonFromFile(string& jFile, Json::Value *root, string *errMsg)
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <limits.h>
 
@@ -57,6 +58,7 @@ bool file_exists(const char *filename);
 
 string endlbr();
 string readFile(string file);
+void* mapSharedFile(string file, size_t size, uint32_t magic, uint32_t version, int* fd, bool* fresh);
 bool parseJsonFromFile(string& jFile, Json::Value *root, string *errMsg);
 bool parseJsonFromString(string& jData, Json::Value *root, string *errMsg);
 string writeJson2String(Json::Value json, string indent="");
@@ -0,0 +1,184 @@
+
+#include <sys/types.h>
+#include <errno.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "common/helpers.h"
+#include "compress.h"
+
+CEncoder::CEncoder(int enc)
+{
+	encoding = enc;
+	ready = false;
+	memset(&zs, 0, sizeof(zs));
+#ifdef ENABLE_ZSTD
+	zcs = NULL;
+#endif
+
+	if ((encoding == encGzip) || (encoding == encDeflate)) {
+		/* windowBits + 16: gzip wrapper, otherwise zlib wrapper as required for 'deflate' */
+		int windowBits = (encoding == encGzip) ? 15 + 16 : 15;
+		ready = (deflateInit2(&zs, 6, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+	}
+#ifdef ENABLE_ZSTD
+	else if (encoding == encZstd) {
+		zcs = ZSTD_createCStream();
+		ready = ((zcs != NULL) && !ZSTD_isError(ZSTD_initCStream(zcs, 3)));
+	}
+#endif
+	if (!ready)
+		encoding = encIdentity;
+}
+
+CEncoder::~CEncoder()
+{
+	if ((encoding == encGzip) || (encoding == encDeflate))
+		deflateEnd(&zs);
+#ifdef ENABLE_ZSTD
+	if (zcs != NULL)
+		ZSTD_freeCStream(zcs);
+#endif
+}
+
+/*
+ * Pick the encoding from the Accept-Encoding header,
+ * preferred: zstd (if compiled in), gzip, deflate.
+ */
+int CEncoder::negotiate(string acceptEncoding)
+{
+	bool hasGzip = false, hasDeflate = false, hasZstd = false;
+	vector<string> v = split(acceptEncoding, ',');
+	for (size_t i = 0; i < v.size(); i++) {
+		vector<string> params = split(v[i], ';');
+		if (params.empty())
+			continue;
+		string name = str_tolower(trim(params[0]));
+		bool allowed = true;
+		for (size_t j = 1; j < params.size(); j++) {
+			string param = trim(params[j]);
+			if (param.find("q=") == 0)
+				allowed = (atof(param.substr(2).c_str()) > 0.0);
+		}
+		if (!allowed)
+			continue;
+		if ((name == "gzip") || (name == "x-gzip"))
+			hasGzip = true;
+		else if (name == "deflate")
+			hasDeflate = true;
+		else if (name == "zstd")
+			hasZstd = true;
+	}
+
+#ifdef ENABLE_ZSTD
+	if (hasZstd)
+		return encZstd;
+#else
+	(void)hasZstd;
+#endif
+	if (hasGzip)
+		return encGzip;
+	if (hasDeflate)
+		return encDeflate;
+	return encIdentity;
+}
+
+const char* CEncoder::encodingName(int enc)
+{
+	switch (enc) {
+		case encGzip:
+			return "gzip";
+		case encDeflate:
+			return "deflate";
+		case encZstd:
+			return "zstd";
+		default:
+			return "";
+	}
+}
+
+/* One-shot encoding, e.g. for responses stored in pre-compressed form */
+string CEncoder::encode(int enc, const string& data)
+{
+	CEncoder encoder(enc);
+	if (encoder.getEncoding() == encIdentity)
+		return data;
+
+	string ret;
+	ret.reserve(data.length() / 4 + 64);
+	if (!encoder.write(data.data(), data.length(), ret) || !encoder.finish(ret))
+		return "";
+	return ret;
+}
+
+bool CEncoder::deflateData(const char* data, size_t len, int flush, string& out)
+{
+	char chunk[16*1024];
+	zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+	zs.avail_in = static_cast<uInt>(len);
+	do {
+		zs.next_out = reinterpret_cast<Bytef*>(chunk);
+		zs.avail_out = sizeof(chunk);
+		int ret = deflate(&zs, flush);
+		if ((ret == Z_STREAM_ERROR) || ((ret == Z_BUF_ERROR) && (zs.avail_out == sizeof(chunk)) && (zs.avail_in > 0)))
+			return false;
+		out.append(chunk, sizeof(chunk) - zs.avail_out);
+	} while ((zs.avail_out == 0) || (zs.avail_in > 0));
+	return true;
+}
+
+#ifdef ENABLE_ZSTD
+bool CEncoder::zstdData(const char* data, size_t len, ZSTD_EndDirective mode, string& out)
+{
+	char chunk[16*1024];
+	ZSTD_inBuffer in = { data, len, 0 };
+	size_t remaining;
+	do {
+		ZSTD_outBuffer zout = { chunk, sizeof(chunk), 0 };
+		remaining = ZSTD_compressStream2(zcs, &zout, &in, mode);
+		if (ZSTD_isError(remaining))
+			return false;
+		out.append(chunk, zout.pos);
+	} while ((in.pos < in.size) || ((mode != ZSTD_e_continue) && (remaining > 0)));
+	return true;
+}
+#endif
+
+bool CEncoder::write(const char* data, size_t len, string& out)
+{
+	if (len == 0)
+		return true;
+	if (encoding == encIdentity) {
+		out.append(data, len);
+		return true;
+	}
+#ifdef ENABLE_ZSTD
+	if (encoding == encZstd)
+		return zstdData(data, len, ZSTD_e_continue, out);
+#endif
+	return deflateData(data, len, Z_NO_FLUSH, out);
+}
+
+bool CEncoder::flush(string& out)
+{
+	if (encoding == encIdentity)
+		return true;
+#ifdef ENABLE_ZSTD
+	if (encoding == encZstd)
+		return zstdData("", 0, ZSTD_e_flush, out);
+#endif
+	return deflateData("", 0, Z_SYNC_FLUSH, out);
+}
+
+bool CEncoder::finish(string& out)
+{
+	if (encoding == encIdentity)
+		return true;
+#ifdef ENABLE_ZSTD
+	if (encoding == encZstd)
+		return zstdData("", 0, ZSTD_e_end, out);
+#endif
+	return deflateData("", 0, Z_FINISH, out);
+}
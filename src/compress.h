@@ -0,0 +1,58 @@
+
+#ifndef __COMPRESS_H__
+#define __COMPRESS_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <zlib.h>
+#ifdef ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <string>
+
+using namespace std;
+
+/* Streaming encoder for HTTP content encodings */
+class CEncoder
+{
+	private:
+		int encoding;
+		bool ready;
+		z_stream zs;
+#ifdef ENABLE_ZSTD
+		ZSTD_CStream* zcs;
+#endif
+
+		bool deflateData(const char* data, size_t len, int flush, string& out);
+#ifdef ENABLE_ZSTD
+		bool zstdData(const char* data, size_t len, ZSTD_EndDirective mode, string& out);
+#endif
+
+	public:
+		enum {
+			encIdentity,
+			encDeflate,
+			encGzip,
+			encZstd
+		};
+
+		CEncoder(int enc);
+		~CEncoder();
+
+		static int negotiate(string acceptEncoding);
+		static const char* encodingName(int enc);
+		static string encode(int enc, const string& data);
+
+		int getEncoding() { return encoding; };
+		bool write(const char* data, size_t len, string& out);
+		bool flush(string& out);
+		bool finish(string& out);
+};
+
+
+#endif // __COMPRESS_H__
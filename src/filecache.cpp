@@ -0,0 +1,115 @@
+
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+
+#include <string>
+
+#include "mt-api.h"
+#include "metrics.h"
+#include "filecache.h"
+
+extern CMtApi*		g_mainInstance;
+
+CFileCache		g_fileCache;
+
+CFileCache::mapping_t::~mapping_t()
+{
+	if (addr != NULL)
+		munmap(addr, size);
+}
+
+static time_t monotonicSec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
+
+static bool sameFile(const struct stat& st, dev_t dev, ino_t ino, off_t size, const struct timespec& mtime)
+{
+	return ((st.st_dev == dev) && (st.st_ino == ino) && (st.st_size == size) &&
+		(st.st_mtim.tv_sec == mtime.tv_sec) && (st.st_mtim.tv_nsec == mtime.tv_nsec));
+}
+
+bool CFileCache::mapFile(const string& file, entry_t* entry)
+{
+	int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if ((fstat(fd, &st) != 0) || !S_ISREG(st.st_mode)) {
+		close(fd);
+		return false;
+	}
+
+	shared_ptr<mapping_t> m = make_shared<mapping_t>();
+	m->addr = NULL;
+	m->size = static_cast<size_t>(st.st_size);
+	/* empty files can't be mapped */
+	if (m->size > 0) {
+		void* p = mmap(NULL, m->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED) {
+			close(fd);
+			return false;
+		}
+		m->addr = p;
+	}
+	close(fd);
+
+	entry->map	= m;
+	entry->dev	= st.st_dev;
+	entry->ino	= st.st_ino;
+	entry->size	= st.st_size;
+	entry->mtime	= st.st_mtim;
+	return true;
+}
+
+bool CFileCache::get(const string& file, view_t* view)
+{
+	lock_guard<mutex> guard(lock);
+	time_t now = monotonicSec();
+
+	map<string, entry_t>::iterator it = entries.find(file);
+	bool hit = false;
+	if (it != entries.end()) {
+		entry_t& e = it->second;
+		if (now - e.checked < checkInterval)
+			hit = true;
+		else {
+			struct stat st;
+			if (stat(file.c_str(), &st) != 0)
+				entries.erase(it);
+			else if (sameFile(st, e.dev, e.ino, e.size, e.mtime)) {
+				e.checked = now;
+				hit = true;
+			}
+		}
+	}
+
+	if ((g_mainInstance != NULL) && (g_mainInstance->metrics != NULL))
+		g_mainInstance->metrics->countCache(CMetrics::cacheFile, hit);
+
+	if (!hit) {
+		entry_t e;
+		if (!mapFile(file, &e)) {
+			entries.erase(file);
+			return false;
+		}
+		e.checked = now;
+		entries[file] = e;
+	}
+
+	const entry_t& e = entries[file];
+	view->map	= e.map;
+	view->data	= (e.map->addr != NULL) ? static_cast<const char*>(e.map->addr) : "";
+	view->size	= e.map->size;
+	return true;
+}
+
+void CFileCache::clear()
+{
+	lock_guard<mutex> guard(lock);
+	entries.clear();
+}
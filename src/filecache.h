@@ -0,0 +1,72 @@
+
+#ifndef __FILECACHE_H__
+#define __FILECACHE_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+
+using namespace std;
+
+/*
+ * Read-only data files, mapped once per process and shared as views.
+ * An entry is checked against inode, size and mtime of the file at most
+ * once per checkInterval, replaced files (rename) are mapped again.
+ * Files must be replaced, not rewritten in place: a mapping of a file
+ * that shrinks under it faults on access.
+ */
+class CFileCache
+{
+	public:
+		struct mapping_t {
+			void* addr;
+			size_t size;
+			~mapping_t();
+		};
+
+		typedef struct {
+			const char* data;
+			size_t size;
+			shared_ptr<const mapping_t> map;	/* keeps data valid */
+		} view_t;
+
+	private:
+		enum {
+			checkInterval = 1	/* s */
+		};
+
+		struct entry_t {
+			shared_ptr<const mapping_t> map;
+			dev_t dev;
+			ino_t ino;
+			off_t size;
+			struct timespec mtime;
+			time_t checked;
+		};
+
+		map<string, entry_t> entries;
+		mutex lock;
+
+		bool mapFile(const string& file, entry_t* entry);
+
+	public:
+		CFileCache() {};
+		~CFileCache() {};
+
+		bool get(const string& file, view_t* view);
+		void clear();
+};
+
+extern CFileCache g_fileCache;
+
+
+#endif // __FILECACHE_H__
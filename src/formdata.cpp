@@ -0,0 +1,86 @@
+
+#include <string>
+
+#include "net.h"
+#include "formdata.h"
+
+CFormData::CFormData()
+{
+	memset(table, 0, sizeof(table));
+	count = 0;
+}
+
+/* FNV-1a */
+uint32_t CFormData::hash(const char* data, size_t len)
+{
+	uint32_t h = 2166136261u;
+	for (size_t i = 0; i < len; i++) {
+		h ^= static_cast<unsigned char>(data[i]);
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/* the slot holding key, or the free slot it belongs into */
+CFormData::field_t* CFormData::slot(const char* key, size_t len)
+{
+	size_t i = hash(key, len) & (tableSize - 1);
+	for (;;) {
+		field_t* f = &table[i];
+		if (!f->used || ((f->key.len == len) && (memcmp(f->key.data, key, len) == 0)))
+			return f;
+		i = (i + 1) & (tableSize - 1);
+	}
+}
+
+void CFormData::parse(string data)
+{
+	memset(table, 0, sizeof(table));
+	count = 0;
+	source = move(data);
+
+	const char* p = source.data();
+	const char* end = p + source.length();
+	while ((p < end) && (count < maxFields)) {
+		const char* amp = static_cast<const char*>(memchr(p, '&', end - p));
+		if (amp == NULL)
+			amp = end;
+		const char* eq = static_cast<const char*>(memchr(p, '=', amp - p));
+		size_t keyLen = ((eq != NULL) ? eq : amp) - p;
+		if (keyLen > 0) {
+			field_t* f = slot(p, keyLen);
+			if (!f->used) {
+				f->used		= true;
+				f->key.data	= p;
+				f->key.len	= keyLen;
+				f->value.data	= amp;
+				f->value.len	= 0;
+				count++;
+			}
+			if ((f->value.len == 0) && (eq != NULL)) {
+				f->value.data	= eq + 1;
+				f->value.len	= amp - (eq + 1);
+			}
+		}
+		p = amp + 1;
+	}
+}
+
+/* raw (still encoded) value */
+bool CFormData::find(const char* key, strView_t* value)
+{
+	field_t* f = slot(key, strlen(key));
+	if (!f->used)
+		return false;
+	*value = f->value;
+	return true;
+}
+
+string CFormData::get(const char* key)
+{
+	string ret = "";
+	strView_t v;
+	if (find(key, &v) && (v.len > 0))
+		CNet::decodeData(v.data, v.len, ret);
+	return ret;
+}
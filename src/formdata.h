@@ -0,0 +1,66 @@
+
+#ifndef __FORMDATA_H__
+#define __FORMDATA_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+using namespace std;
+
+/* pointer and length into a buffer owned by someone else */
+typedef struct {
+	const char* data;
+	size_t len;
+} strView_t;
+
+/*
+ * Fields of a query string or urlencoded form body (k=v&k=v). parse()
+ * takes over the buffer and indexes it in one pass, keys and values are
+ * views into it. Lookups hash the key into a fixed open addressing
+ * table, get() percent-decodes only the value asked for. A repeated key
+ * keeps its first non-empty value; fields beyond maxFields are ignored.
+ */
+class CFormData
+{
+	public:
+		enum {
+			maxFields = 48
+		};
+
+	private:
+		enum {
+			tableSize = 64	/* power of 2, > maxFields */
+		};
+
+		struct field_t {
+			strView_t key;
+			strView_t value;
+			bool used;
+		};
+
+		string source;
+		field_t table[tableSize];
+		size_t count;
+
+		static uint32_t hash(const char* data, size_t len);
+		field_t* slot(const char* key, size_t len);
+
+	public:
+		CFormData();
+		CFormData(const CFormData&) = delete;
+		CFormData& operator=(const CFormData&) = delete;
+		~CFormData() {};
+
+		void parse(string data);
+		bool find(const char* key, strView_t* value);
+		string get(const char* key);
+		size_t size() { return count; };
+};
+
+
+#endif // __FORMDATA_H__
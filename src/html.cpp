@@ -5,22 +5,26 @@
 #include <fcntl.h>
 #include <libgen.h>
 #include <errno.h>
-#include <tidy.h>
-#include <tidybuffio.h>
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <climits>
+#include <iomanip>
+#include <algorithm>
+#include <vector>
 #include <string>
 
 #include "common/helpers.h"
+#include "mt-api.h"
 #include "html.h"
+#include "template.h"
+#include "timing.h"
 
+extern CMtApi*		g_mainInstance;
 extern const char*	g_progName;
 extern const char*	g_progVersion;
 extern const char*	g_progCopyright;
-extern string		g_dataRoot;
 extern string		g_msgBoxText;
 
 CHtml::CHtml()
@@ -63,9 +67,8 @@ string CHtml::getHtmlHeader(string title, int flags, string extraHeader/*=""*/)
 #ifdef SASS_VERSION
 	sass_vers = ", SASS " + string(SASS_VERSION);
 #endif
-	string tidy_vers = " and HTML Tidy for Linux v" + string(tidyLibraryVersion());
 		ret += " \
-		<meta name=\"generator\" content=\"" + gcc_vers + sass_vers + tidy_vers + "\" />\n";
+		<meta name=\"generator\" content=\"" + gcc_vers + sass_vers + "\" />\n";
 	}
 	if ((flags & includeCopyR) == includeCopyR) {
 		ret += " \
@@ -92,7 +95,7 @@ string CHtml::getHtmlHeader(string title, int flags, string extraHeader/*=""*/)
 
 string CHtml::getHtmlFooter(string templ, string tagBefore)
 {
-	return tagBefore + readFile(templ);
+	return tagBefore + g_mainInstance->templates()->render(templ.c_str());
 }
 
 string CHtml::getIndexSite()
@@ -106,8 +109,7 @@ string CHtml::getIndexSite()
 		<link rel=\"stylesheet\" type=\"text/css\" href=\"/css/index.css\" />\n \
 		";
 	ret << getHtmlHeader("Coolithek", headerFlags, extraHeader);
-	string html = readFile(g_dataRoot + "/template/index.html");
-	ret << html << endl;
+	ret << g_mainInstance->templates()->render("index.html") << endl;
 	ret << "</body></html>" << endl;
 	return ret.str();
 }
@@ -123,7 +125,6 @@ string CHtml::getErrorSite(int errNum, string site)
 		<link rel=\"stylesheet\" type=\"text/css\" href=\"/css/error.css\" />\n \
 		";
 	ret << getHtmlHeader("Coolithek - Error " + std::to_string(errNum), headerFlags, extraHeader);
-	string html = readFile(g_dataRoot + "/template/error.html");
 
 	string errText;
 	if (errNum == 403) {
@@ -137,8 +138,44 @@ string CHtml::getErrorSite(int errNum, string site)
 		errText = "Unbekannt der Fehler mir ist.";
 	}
 
-	html = str_replace("@@@ERR_NUM@@@", to_string(errNum), html);
-	ret << str_replace("@@@ERR_TXT@@@", errText, html) << endl;
+	ret << g_mainInstance->templates()->render("error.html", { { "ERR_NUM", to_string(errNum) }, { "ERR_TXT", errText } }) << endl;
 	ret << "</body></html>" << endl;
 	return ret.str();
 }
+
+/* Stages of the request as a waterfall, ordered by their start */
+string CHtml::getTimingWaterfall(CStageTimer* timer)
+{
+	int64_t total = timer->elapsed();
+	if (total <= 0)
+		total = 1;
+
+	vector<int> order;
+	for (int i = 0; i < CStageTimer::stageCount; i++) {
+		if (timer->getCalls(i) > 0)
+			order.push_back(i);
+	}
+	sort(order.begin(), order.end(), [timer](int a, int b) { return timer->getFirst(a) < timer->getFirst(b); });
+
+	stringstream rows;
+	rows.setf(ios::fixed);
+	for (size_t i = 0; i < order.size(); i++) {
+		int stage = order[i];
+		double left  = 100.0 * static_cast<double>(timer->getFirst(stage)) / static_cast<double>(total);
+		double width = 100.0 * static_cast<double>(timer->getDuration(stage)) / static_cast<double>(total);
+		rows << "          <tr>";
+		rows << "<td class='timingName'>" << CStageTimer::stageName(stage) << "</td>";
+		rows << "<td><div class='timingBar' style='margin-left: " << setprecision(2) << left << "%; width: " << width << "%;'></div></td>";
+		rows << "<td class='timingValue'>" << setprecision(3) << static_cast<double>(timer->getDuration(stage)) / 1000000.0 << " ms</td>";
+		rows << "</tr>\n";
+	}
+
+	char totalMs[32];
+	snprintf(totalMs, sizeof(totalMs), "%.3f", static_cast<double>(total) / 1000000.0);
+
+	return g_mainInstance->templates()->render("timing.html", {
+		{ "REQ_ID", timer->getRequestId() },
+		{ "TOTAL", totalMs },
+		{ "ROWS", rows.str() }
+	});
+}
@@ -12,6 +12,8 @@
 
 using namespace std;
 
+class CStageTimer;
+
 class CHtml
 {
 	private:
@@ -34,6 +36,7 @@ class CHtml
 		string getHtmlFooter(string templ, string tagBefore="");
 		string getIndexSite();
 		string getErrorSite(int errNum, string site);
+		string getTimingWaterfall(CStageTimer* timer);
 
 };
 
@@ -29,10 +29,16 @@ class CJson
 		void parseError(const char* func, int line, string msg="");
 		void resetQueryHeaderStruct(query_header_t* qh);
 		void resetCmdListVideoStruct(cmdListVideo_t* lv);
-		bool parseListVideo(Json::Value root);
+		void parseListVideoCmd(Json::Value root, cmdListVideo_t* lv);
+		bool parseQueryHeader(Json::Value& root, query_header_t* qh);
+		void resetBatchRequestStruct(batchRequest_t* br);
 		bool asBool(Json::Value::iterator it);
 
 	public:
+		enum {
+			maxBatchRequests = 16,
+			parallelRows	 = 64	/* least rows per worker when serializing a page */
+		};
 
 		CJson();
 		~CJson();
@@ -46,12 +52,19 @@ class CJson
 		void resetListVideoStruct(listVideo_t* lv);
 		void resetListVideoHeadStruct(listVideoHead_t* lvh);
 		bool parsePostData(string jData);
+		bool parsePostQuery(string jData, cmdListVideo_t* clv);
+		bool parseBatch(string jData, vector<batchRequest_t>& br);
 		string styledJson(string json);
 		string styledJson(Json::Value json);
 		string progInfo2Json(progInfo_t* pi, string indent="");
 		string liveStreamList2Json(vector<livestreams_t>& ls, string indent="");
 		string channelList2Json(vector<channels_t>& ch, string indent="");
 		string videoList2Json(string indent="");
+		string videoList2Json(listVideoHead_t* lvh, vector<listVideo_t>& lv, string indent="");
+		string videoEntries2Json(vector<listVideo_t>& lv, size_t workers);
+		Json::Value videoListHead2Json(listVideoHead_t* lvh);
+		Json::Value videoEntry2Json(listVideo_t* lv);
+		string batch2Json(vector<batchRequest_t>& br, string indent="");
 		string jsonErrMsg(string msg, int err=1);
 		string json2String(Json::Value json, string indent="");
 		string formatJson(string data, string tagBefore="", string tagAfter="");
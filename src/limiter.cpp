@@ -0,0 +1,204 @@
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+
+#include <string>
+
+#include "common/helpers.h"
+#include "limiter.h"
+
+static const uint32_t limiterMagic	= 0x4d544c31; /* "MTL1" */
+static const uint32_t limiterVersion	= 1;
+
+static const int64_t tokenScale		= 1000000;
+
+CLimiter::CLimiter(string file)
+{
+	shmFile		= file;
+	fd		= -1;
+	data		= NULL;
+	dbSlot		= -1;
+	retryAfter	= 1;
+
+	const char* rateEnv = getenv("MT_API_RATE_LIMIT");
+	const char* burstEnv = getenv("MT_API_RATE_BURST");
+	const char* dbEnv = getenv("MT_API_MAX_DB_REQUESTS");
+	rate	= (rateEnv && *rateEnv) ? atof(rateEnv) : 10.0;
+	burst	= (burstEnv && *burstEnv) ? atoll(burstEnv) : static_cast<int64_t>(3 * rate + 0.5);
+	if (burst < 1)
+		burst = 1;
+	maxDb	= (dbEnv && *dbEnv) ? atoi(dbEnv) : 32;
+	if (maxDb > maxDbSlots)
+		maxDb = maxDbSlots;
+
+	if ((rate > 0) || (maxDb > 0))
+		attach();
+}
+
+CLimiter::~CLimiter()
+{
+	releaseDb();
+	if (data != NULL)
+		munmap(data, sizeof(limiterData_t));
+	if (fd >= 0)
+		close(fd);
+}
+
+/* without the mapping nothing is limited */
+bool CLimiter::attach()
+{
+	/* the first process (or the first one with a new data layout) initializes the mapping */
+	bool fresh;
+	void* p = mapSharedFile(shmFile, sizeof(limiterData_t), limiterMagic, limiterVersion, &fd, &fresh);
+	if (p == NULL) {
+		fd = -1;
+		return false;
+	}
+	data = static_cast<limiterData_t*>(p);
+	if (fresh) {
+		memset(data, 0, sizeof(limiterData_t));
+		data->version	= limiterVersion;
+		data->magic	= limiterMagic;
+	}
+	unlock();
+
+	return (data != NULL);
+}
+
+bool CLimiter::lock()
+{
+	int ret;
+	while (((ret = flock(fd, LOCK_EX)) != 0) && (errno == EINTR))
+		;
+	return (ret == 0);
+}
+
+void CLimiter::unlock()
+{
+	flock(fd, LOCK_UN);
+}
+
+/* FNV-1a, never 0 */
+uint64_t CLimiter::hashKey(const string& addr)
+{
+	uint64_t h = 14695981039346656037ULL;
+	for (size_t i = 0; i < addr.length(); i++) {
+		h ^= static_cast<unsigned char>(addr[i]);
+		h *= 1099511628211ULL;
+	}
+	return (h != 0) ? h : 1;
+}
+
+int64_t CLimiter::now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * Takes a token from the bucket of addr. A client not in the table
+ * starts with a full bucket; when the probed entries are all taken the
+ * one unused for the longest time is given to the new client.
+ */
+bool CLimiter::allowClient(const string& addr)
+{
+	if ((data == NULL) || (rate <= 0) || addr.empty())
+		return true;
+
+	uint64_t key = hashKey(addr);
+	int64_t t = now();
+	if (!lock())
+		return true;
+
+	bucket_t* b = NULL;
+	bucket_t* oldest = NULL;
+	for (size_t i = 0; i < bucketProbe; i++) {
+		bucket_t* e = &data->buckets[(key + i) & (bucketCount - 1)];
+		if (e->key == key) {
+			b = e;
+			break;
+		}
+		if ((oldest == NULL) || (e->key == 0) || ((oldest->key != 0) && (e->last < oldest->last)))
+			oldest = e;
+	}
+	if (b == NULL) {
+		b = oldest;
+		b->key		= key;
+		b->tokens	= burst * tokenScale;
+		b->last		= t;
+	}
+
+	/* refill: rate tokens per s = rate * tokenScale / 1e9 per ns */
+	if (t > b->last) {
+		b->tokens += static_cast<int64_t>(static_cast<double>(t - b->last) * rate * tokenScale / 1e9);
+		if (b->tokens > burst * tokenScale)
+			b->tokens = burst * tokenScale;
+		b->last = t;
+	}
+
+	bool ok = (b->tokens >= tokenScale);
+	if (ok)
+		b->tokens -= tokenScale;
+	else
+		retryAfter = static_cast<int>(static_cast<double>(tokenScale - b->tokens) / (rate * tokenScale)) + 1;
+	unlock();
+
+	return ok;
+}
+
+/* a slot for one request working on the database, released by releaseDb() or the destructor */
+bool CLimiter::acquireDb()
+{
+	if ((data == NULL) || (maxDb <= 0) || (dbSlot >= 0))
+		return true;
+	if (!lock())
+		return true;
+
+	int used = 0;
+	for (int i = 0; i < maxDbSlots; i++) {
+		if (data->dbSlots[i] != 0)
+			used++;
+	}
+	/* at the limit: take back the slots of dead processes */
+	if (used >= maxDb) {
+		for (int i = 0; i < maxDbSlots; i++) {
+			if ((data->dbSlots[i] != 0) && (kill(data->dbSlots[i], 0) != 0) && (errno == ESRCH)) {
+				data->dbSlots[i] = 0;
+				used--;
+			}
+		}
+	}
+
+	if (used < maxDb) {
+		for (int i = 0; i < maxDbSlots; i++) {
+			if (data->dbSlots[i] == 0) {
+				data->dbSlots[i] = getpid();
+				dbSlot = i;
+				break;
+			}
+		}
+	}
+	unlock();
+
+	retryAfter = 1;
+	return (dbSlot >= 0);
+}
+
+void CLimiter::releaseDb()
+{
+	if ((data == NULL) || (dbSlot < 0))
+		return;
+	if (lock()) {
+		if (data->dbSlots[dbSlot] == getpid())
+			data->dbSlots[dbSlot] = 0;
+		unlock();
+	}
+	dbSlot = -1;
+}
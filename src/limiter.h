@@ -0,0 +1,78 @@
+
+#ifndef __LIMITER_H__
+#define __LIMITER_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include <string>
+
+using namespace std;
+
+/*
+ * Admission control shared by all CGI processes through a file mapping
+ * (<cache>/limits.shm): a token bucket per client address and a cap on
+ * requests working on the database at the same time. Both tables are
+ * changed under flock() on the file, which the kernel releases when a
+ * process dies; database slots carry the pid of their owner and slots
+ * of dead processes are taken back.
+ *
+ * MT_API_RATE_LIMIT	requests/s per client (default 10, 0: off)
+ * MT_API_RATE_BURST	bucket size (default 3 * rate)
+ * MT_API_MAX_DB_REQUESTS	concurrent database requests (default 32, 0: off)
+ */
+class CLimiter
+{
+	public:
+		enum {
+			maxDbSlots	= 256,
+			bucketCount	= 4096,	/* power of 2 */
+			bucketProbe	= 8
+		};
+
+	private:
+		struct bucket_t {
+			uint64_t key;		/* hash of the address, 0: free */
+			int64_t tokens;		/* 1/1000000 tokens */
+			int64_t last;		/* ns, CLOCK_MONOTONIC */
+		};
+
+		/* layout of the shared mapping, bump limiterVersion on changes */
+		struct limiterData_t {
+			uint32_t magic;
+			uint32_t version;
+			pid_t dbSlots[maxDbSlots];
+			bucket_t buckets[bucketCount];
+		};
+
+		string shmFile;
+		int fd;
+		limiterData_t* data;
+		double rate;
+		int64_t burst;
+		int maxDb;
+		int dbSlot;
+		int retryAfter;
+
+		bool attach();
+		bool lock();
+		void unlock();
+		static uint64_t hashKey(const string& addr);
+		static int64_t now();
+
+	public:
+		CLimiter(string file);
+		~CLimiter();
+
+		bool allowClient(const string& addr);
+		bool acquireDb();
+		void releaseDb();
+		int getRetryAfter() { return retryAfter; };
+};
+
+
+#endif // __LIMITER_H__
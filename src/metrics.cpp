@@ -0,0 +1,283 @@
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+
+#include <string>
+
+#include "common/helpers.h"
+#include "metrics.h"
+
+static const uint32_t metricsMagic	= 0x4d544d31; /* "MTM1" */
+static const uint32_t metricsVersion	= 5;
+
+/* histogram bounds: nanoseconds, rows, bytes */
+static const uint64_t timeBounds[] = {
+	250000ULL, 500000ULL, 1000000ULL, 2500000ULL, 5000000ULL, 10000000ULL, 25000000ULL, 50000000ULL,
+	100000000ULL, 250000000ULL, 500000000ULL, 1000000000ULL, 2500000000ULL, 5000000000ULL, 10000000000ULL
+};
+static const uint64_t rowBounds[] = {
+	0, 1, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000
+};
+static const uint64_t byteBounds[] = {
+	128, 512, 1024, 4096, 16384, 65536, 262144, 1048576, 4194304, 16777216
+};
+#define BOUNDS(b) b, static_cast<int>(sizeof(b) / sizeof(b[0]))
+
+static const char* endpointLabels[CMetrics::epCount][2] = {
+	{ "api",   "info" },
+	{ "api",   "listvideos" },
+	{ "api",   "listlivestream" },
+	{ "api",   "listchannels" },
+	{ "api",   "batch" },
+	{ "api",   "catalog" },
+	{ "api",   "catalogpatch" },
+	{ "api",   "cataloginfo" },
+	{ "api",   "metrics" },
+	{ "api",   "other" },
+	{ "index", "" },
+	{ "page",  "" },
+	{ "other", "" }
+};
+
+static const char* cacheLabels[CMetrics::cacheCount] = {
+	"catalog",
+	"sqlite",
+	"file",
+	"response",
+	"flight"
+};
+
+static const char* rejectLabels[CMetrics::rejectCount] = {
+	"rate",
+	"busy"
+};
+
+CMetrics::CMetrics(string file)
+{
+	shmFile = file;
+	data = NULL;
+	attach();
+}
+
+CMetrics::~CMetrics()
+{
+	if (data != NULL)
+		munmap(data, sizeof(metricsData_t));
+}
+
+bool CMetrics::attach()
+{
+	/* the first process (or the first one with a new data layout) initializes the mapping */
+	int fd;
+	bool fresh;
+	void* p = mapSharedFile(shmFile, sizeof(metricsData_t), metricsMagic, metricsVersion, &fd, &fresh);
+	if (p == NULL)
+		return false;
+	data = static_cast<metricsData_t*>(p);
+	if (fresh) {
+		memset(data, 0, sizeof(metricsData_t));
+		data->startTime	= static_cast<uint64_t>(time(NULL));
+		data->version	= metricsVersion;
+		data->magic	= metricsMagic;
+	}
+	flock(fd, LOCK_UN);
+	close(fd);
+
+	return (data != NULL);
+}
+
+void CMetrics::add(uint64_t* counter, uint64_t val)
+{
+	__atomic_fetch_add(counter, val, __ATOMIC_RELAXED);
+}
+
+uint64_t CMetrics::get(const uint64_t* counter)
+{
+	return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+void CMetrics::observe(histogram_t* h, const uint64_t* bounds, int boundCount, uint64_t val)
+{
+	int i = 0;
+	while ((i < boundCount) && (val > bounds[i]))
+		i++;
+	add(&h->buckets[i], 1);
+	add(&h->count, 1);
+	add(&h->sum, val);
+}
+
+int CMetrics::endpointIndex(string modeLower, string subLower)
+{
+	if (modeLower.empty() || (modeLower == "index"))
+		return epIndex;
+	if ((modeLower.find("page") == 3) && (modeLower.length() == 7))
+		return epErrorPage;
+	if (modeLower != "api")
+		return epOther;
+	for (int i = 0; i < epApiOther; i++) {
+		if (subLower == endpointLabels[i][1])
+			return i;
+	}
+	return epApiOther;
+}
+
+void CMetrics::countRequest(int endpoint)
+{
+	if ((data == NULL) || (endpoint < 0) || (endpoint >= epCount))
+		return;
+	add(&data->requests[endpoint], 1);
+}
+
+void CMetrics::countCache(int cache, bool hit)
+{
+	if ((data == NULL) || (cache < 0) || (cache >= cacheCount))
+		return;
+	add((hit) ? &data->cacheHits[cache] : &data->cacheMisses[cache], 1);
+}
+
+void CMetrics::countDbError()
+{
+	if (data == NULL)
+		return;
+	add(&data->dbErrors, 1);
+}
+
+void CMetrics::countRejected(int reason)
+{
+	if ((data == NULL) || (reason < 0) || (reason >= rejectCount))
+		return;
+	add(&data->rejected[reason], 1);
+}
+
+void CMetrics::recordRequest(CStageTimer* timer, uint64_t rows, uint64_t bytes)
+{
+	if ((data == NULL) || (timer == NULL))
+		return;
+
+	observe(&data->duration, BOUNDS(timeBounds), static_cast<uint64_t>(timer->elapsed()));
+	uint64_t db = 0;
+	bool dbUsed = false;
+	for (int i = 0; i < CStageTimer::stageCount; i++) {
+		if (timer->getCalls(i) == 0)
+			continue;
+		uint64_t d = static_cast<uint64_t>(timer->getDuration(i));
+		observe(&data->stages[i], BOUNDS(timeBounds), d);
+		if ((i == CStageTimer::stageCountQuery) || (i == CStageTimer::stagePageQuery) || (i == CStageTimer::stageQuery)) {
+			db += d;
+			dbUsed = true;
+		}
+	}
+	if (dbUsed) {
+		observe(&data->dbDuration, BOUNDS(timeBounds), db);
+		observe(&data->rows, BOUNDS(rowBounds), rows);
+	}
+	observe(&data->responseBytes, BOUNDS(byteBounds), bytes);
+}
+
+/* scale: factor from the stored unit to the exported one (ns -> s) */
+void CMetrics::histogram2Text(string& out, const char* name, const char* labels, const histogram_t* h, const uint64_t* bounds, int boundCount, double scale)
+{
+	char buf[256];
+	string sep = (labels[0] != '\0') ? "," : "";
+	uint64_t cumulative = 0;
+	for (int i = 0; i < boundCount; i++) {
+		cumulative += get(&h->buckets[i]);
+		snprintf(buf, sizeof(buf), "%s_bucket{%s%sle=\"%g\"} %llu\n", name, labels, sep.c_str(),
+			 static_cast<double>(bounds[i]) * scale, static_cast<unsigned long long>(cumulative));
+		out += buf;
+	}
+	cumulative += get(&h->buckets[boundCount]);
+	snprintf(buf, sizeof(buf), "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, sep.c_str(), static_cast<unsigned long long>(cumulative));
+	out += buf;
+	string l = (labels[0] != '\0') ? "{" + string(labels) + "}" : "";
+	snprintf(buf, sizeof(buf), "%s_sum%s %.9g\n", name, l.c_str(), static_cast<double>(get(&h->sum)) * scale);
+	out += buf;
+	snprintf(buf, sizeof(buf), "%s_count%s %llu\n", name, l.c_str(), static_cast<unsigned long long>(get(&h->count)));
+	out += buf;
+}
+
+string CMetrics::metrics2Text()
+{
+	if (data == NULL)
+		return "# metrics not available\n";
+
+	string out;
+	out.reserve(32*1024);
+	char buf[256];
+
+	out += "# HELP mtapi_start_time_seconds Time the counters were (re)initialized.\n";
+	out += "# TYPE mtapi_start_time_seconds gauge\n";
+	snprintf(buf, sizeof(buf), "mtapi_start_time_seconds %llu\n", static_cast<unsigned long long>(data->startTime));
+	out += buf;
+
+	out += "# HELP mtapi_requests_total Requests by mode and sub.\n";
+	out += "# TYPE mtapi_requests_total counter\n";
+	for (int i = 0; i < epCount; i++) {
+		snprintf(buf, sizeof(buf), "mtapi_requests_total{mode=\"%s\",sub=\"%s\"} %llu\n",
+			 endpointLabels[i][0], endpointLabels[i][1], static_cast<unsigned long long>(get(&data->requests[i])));
+		out += buf;
+	}
+
+	out += "# HELP mtapi_request_duration_seconds Total request latency.\n";
+	out += "# TYPE mtapi_request_duration_seconds histogram\n";
+	histogram2Text(out, "mtapi_request_duration_seconds", "", &data->duration, BOUNDS(timeBounds), 1e-9);
+
+	out += "# HELP mtapi_stage_duration_seconds Latency per request stage.\n";
+	out += "# TYPE mtapi_stage_duration_seconds histogram\n";
+	for (int i = 0; i < CStageTimer::stageCount; i++) {
+		string labels = "stage=\"" + string(CStageTimer::stageName(i)) + "\"";
+		histogram2Text(out, "mtapi_stage_duration_seconds", labels.c_str(), &data->stages[i], BOUNDS(timeBounds), 1e-9);
+	}
+
+	out += "# HELP mtapi_db_query_duration_seconds Database time per request.\n";
+	out += "# TYPE mtapi_db_query_duration_seconds histogram\n";
+	histogram2Text(out, "mtapi_db_query_duration_seconds", "", &data->dbDuration, BOUNDS(timeBounds), 1e-9);
+
+	out += "# HELP mtapi_rows_returned Database rows per request.\n";
+	out += "# TYPE mtapi_rows_returned histogram\n";
+	histogram2Text(out, "mtapi_rows_returned", "", &data->rows, BOUNDS(rowBounds), 1.0);
+
+	out += "# HELP mtapi_response_bytes Response body size as sent.\n";
+	out += "# TYPE mtapi_response_bytes histogram\n";
+	histogram2Text(out, "mtapi_response_bytes", "", &data->responseBytes, BOUNDS(byteBounds), 1.0);
+
+	out += "# HELP mtapi_cache_hits_total Cache hits.\n";
+	out += "# TYPE mtapi_cache_hits_total counter\n";
+	for (int i = 0; i < cacheCount; i++) {
+		snprintf(buf, sizeof(buf), "mtapi_cache_hits_total{cache=\"%s\"} %llu\n", cacheLabels[i], static_cast<unsigned long long>(get(&data->cacheHits[i])));
+		out += buf;
+	}
+	out += "# HELP mtapi_cache_misses_total Cache misses.\n";
+	out += "# TYPE mtapi_cache_misses_total counter\n";
+	for (int i = 0; i < cacheCount; i++) {
+		snprintf(buf, sizeof(buf), "mtapi_cache_misses_total{cache=\"%s\"} %llu\n", cacheLabels[i], static_cast<unsigned long long>(get(&data->cacheMisses[i])));
+		out += buf;
+	}
+	out += "# HELP mtapi_cache_hit_ratio Cache hits / lookups since start.\n";
+	out += "# TYPE mtapi_cache_hit_ratio gauge\n";
+	for (int i = 0; i < cacheCount; i++) {
+		uint64_t hits = get(&data->cacheHits[i]);
+		uint64_t total = hits + get(&data->cacheMisses[i]);
+		snprintf(buf, sizeof(buf), "mtapi_cache_hit_ratio{cache=\"%s\"} %g\n", cacheLabels[i], (total > 0) ? static_cast<double>(hits) / static_cast<double>(total) : 0.0);
+		out += buf;
+	}
+
+	out += "# HELP mtapi_db_errors_total Database errors (connect and query).\n";
+	out += "# TYPE mtapi_db_errors_total counter\n";
+	snprintf(buf, sizeof(buf), "mtapi_db_errors_total %llu\n", static_cast<unsigned long long>(get(&data->dbErrors)));
+	out += buf;
+
+	out += "# HELP mtapi_rejected_total Requests turned away by the rate limit (429) or the database request cap (503).\n";
+	out += "# TYPE mtapi_rejected_total counter\n";
+	for (int i = 0; i < rejectCount; i++) {
+		snprintf(buf, sizeof(buf), "mtapi_rejected_total{reason=\"%s\"} %llu\n", rejectLabels[i], static_cast<unsigned long long>(get(&data->rejected[i])));
+		out += buf;
+	}
+
+	return out;
+}
@@ -0,0 +1,106 @@
+
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "timing.h"
+
+using namespace std;
+
+/*
+ * Request metrics in Prometheus text format. The counters live in a
+ * shared file mapping (<cache>/metrics.shm), so all CGI processes add
+ * to the same numbers; updates are atomic adds, no locking.
+ */
+class CMetrics
+{
+	public:
+		enum {
+			epInfo,
+			epListVideos,
+			epListLivestream,
+			epListChannels,
+			epBatch,
+			epCatalog,
+			epCatalogPatch,
+			epCatalogInfo,
+			epMetrics,
+			epApiOther,
+			epIndex,
+			epErrorPage,
+			epOther,
+			epCount
+		};
+		enum {
+			cacheCatalog,
+			cacheSqlite,
+			cacheFile,
+			cacheResponse,
+			cacheFlight,
+			cacheCount
+		};
+		enum {
+			rejectRate,
+			rejectBusy,
+			rejectCount
+		};
+		enum {
+			maxBuckets = 16
+		};
+
+	private:
+		struct histogram_t {
+			uint64_t buckets[maxBuckets];
+			uint64_t count;
+			uint64_t sum;
+		};
+
+		/* layout of the shared mapping, bump dataVersion on changes */
+		struct metricsData_t {
+			uint32_t magic;
+			uint32_t version;
+			uint64_t startTime;
+			uint64_t requests[epCount];
+			histogram_t duration;
+			histogram_t stages[CStageTimer::stageCount];
+			histogram_t dbDuration;
+			histogram_t rows;
+			histogram_t responseBytes;
+			uint64_t cacheHits[cacheCount];
+			uint64_t cacheMisses[cacheCount];
+			uint64_t dbErrors;
+			uint64_t rejected[rejectCount];
+		};
+
+		string shmFile;
+		metricsData_t* data;
+
+		bool attach();
+		static void add(uint64_t* counter, uint64_t val);
+		static uint64_t get(const uint64_t* counter);
+		static void observe(histogram_t* h, const uint64_t* bounds, int boundCount, uint64_t val);
+		static void histogram2Text(string& out, const char* name, const char* labels, const histogram_t* h, const uint64_t* bounds, int boundCount, double scale);
+
+	public:
+		CMetrics(string file);
+		~CMetrics();
+
+		static int endpointIndex(string modeLower, string subLower);
+
+		void countRequest(int endpoint);
+		void countCache(int cache, bool hit);
+		void countDbError();
+		void countRejected(int reason);
+		void recordRequest(CStageTimer* timer, uint64_t rows, uint64_t bytes);
+		string metrics2Text();
+};
+
+
+#endif // __METRICS_H__
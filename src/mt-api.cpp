@@ -44,9 +44,19 @@
 
 #include "mt-api.h"
 #include "net.h"
+#include "output.h"
 #include "html.h"
 #include "json.h"
-#include "sql.h"
+#include "backend.h"
+#include "catalog.h"
+#include "reqlog.h"
+#include "timing.h"
+#include "metrics.h"
+#include "template.h"
+#include "limiter.h"
+#include "respcache.h"
+#include "singleflight.h"
+#include "workpool.h"
 #include "common/helpers.h"
 
 CMtApi*			g_mainInstance;
@@ -57,6 +67,7 @@ const char*		g_progCopyright;
 string			g_documentRoot;
 string			g_dataRoot;
 string			g_logRoot;
+string			g_cacheRoot;
 bool			g_debugMode;
 int			g_apiMode;
 int			g_queryMode;
@@ -83,47 +94,36 @@ static string sanitizeForLog(string value, size_t maxLen = 512)
 	return value;
 }
 
-static string getRequestLogFilePath()
+/* like sanitizeForLog, but reversible: the payload is replayed by mt-api-replay */
+static string escapeForLog(const string& value, size_t maxLen = 4096)
 {
-	static string logFilePath = "";
-
-	if (!logFilePath.empty())
-		return logFilePath;
-
-	if (!g_logRoot.empty())
-		logFilePath = g_logRoot + "/mt-api.requests.log";
-
-	return logFilePath;
-}
-
-static void appendRequestLog(const string& message)
-{
-	string logFile = getRequestLogFilePath();
-	if (logFile.empty())
-		return;
-
-	ofstream logStream(logFile.c_str(), ios::app);
-	if (!logStream.good())
-		return;
-
-	time_t now = time(NULL);
-	struct tm tmNow;
-	char ts[32];
-	string timestamp;
-	if (localtime_r(&now, &tmNow) != NULL) {
-		strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S%z", &tmNow);
-		timestamp = ts;
-	}
-	else {
-		timestamp = to_string(static_cast<long long>(now));
+	string ret;
+	ret.reserve(value.size() + 16);
+	size_t i;
+	for (i = 0; (i < value.size()) && (ret.size() < maxLen); ++i) {
+		char c = value[i];
+		if (c == '\\')
+			ret += "\\\\";
+		else if (c == '"')
+			ret += "\\\"";
+		else if (c == '\n')
+			ret += "\\n";
+		else if (c == '\r')
+			ret += "\\r";
+		else if (c == '\t')
+			ret += "\\t";
+		else
+			ret += c;
 	}
+	if (i < value.size())
+		ret += "...(truncated)";
 
-	logStream << "[" << timestamp << "] " << message << endl;
+	return ret;
 }
 
-static void logRequestStart(CNet* net, const string& mode)
+static void logRequestStart(CRequestLog* log, CNet* net, const string& mode)
 {
-	if (net == NULL)
+	if ((log == NULL) || (net == NULL))
 		return;
 
 	string method = sanitizeForLog(net->getEnv("REQUEST_METHOD"));
@@ -136,33 +136,31 @@ static void logRequestStart(CNet* net, const string& mode)
 	string query = sanitizeForLog(net->getEnv("QUERY_STRING"));
 	string modeVal = sanitizeForLog(mode);
 
-	stringstream ss;
-	ss << "event=request-start pid=" << getpid();
+	log->beginEvent("request-start");
 	if (!remoteAddr.empty())
-		ss << " remote=\"" << remoteAddr << "\"";
+		log->addField("remote", remoteAddr);
 	if (!host.empty())
-		ss << " host=\"" << host << "\"";
+		log->addField("host", host);
 	if (!method.empty())
-		ss << " method=" << method;
+		log->addField("method", method, false);
 	if (!uri.empty())
-		ss << " uri=\"" << uri << "\"";
+		log->addField("uri", uri);
 	if (!pathInfo.empty())
-		ss << " path_info=\"" << pathInfo << "\"";
+		log->addField("path_info", pathInfo);
 	if (!scriptName.empty())
-		ss << " script=\"" << scriptName << "\"";
+		log->addField("script", scriptName);
 	if (!query.empty())
-		ss << " query=\"" << query << "\"";
+		log->addField("query", query);
 	if (!modeVal.empty())
-		ss << " mode=\"" << modeVal << "\"";
+		log->addField("mode", modeVal);
 	if (!userAgent.empty())
-		ss << " ua=\"" << userAgent << "\"";
-
-	appendRequestLog(ss.str());
+		log->addField("ua", userAgent);
+	log->endEvent();
 }
 
-static void logRequestTarget(CNet* net, const string& mode, const string& submode)
+static void logRequestTarget(CRequestLog* log, CNet* net, const string& mode, const string& submode)
 {
-	if (net == NULL)
+	if ((log == NULL) || (net == NULL))
 		return;
 
 	string modeVal = sanitizeForLog(mode);
@@ -172,78 +170,142 @@ static void logRequestTarget(CNet* net, const string& mode, const string& submod
 
 	string remoteAddr = sanitizeForLog(net->getEnv("REMOTE_ADDR"));
 
-	stringstream ss;
-	ss << "event=request-target pid=" << getpid();
+	log->beginEvent("request-target");
 	if (!remoteAddr.empty())
-		ss << " remote=\"" << remoteAddr << "\"";
+		log->addField("remote", remoteAddr);
 	if (!modeVal.empty())
-		ss << " mode=\"" << modeVal << "\"";
+		log->addField("mode", modeVal);
 	if (!subVal.empty())
-		ss << " sub=\"" << subVal << "\"";
-
-	appendRequestLog(ss.str());
+		log->addField("sub", subVal);
+	log->endEvent();
 }
 
-static void logRequestPayload(CNet* net, const string& mode, const string& submode, const string& payload)
+static void logRequestPayload(CRequestLog* log, CNet* net, const string& mode, const string& submode, const string& payload)
 {
-	if ((net == NULL) || payload.empty())
+	if ((log == NULL) || (net == NULL) || payload.empty())
 		return;
 
 	string remoteAddr = sanitizeForLog(net->getEnv("REMOTE_ADDR"));
 	string modeVal = sanitizeForLog(mode);
 	string subVal = sanitizeForLog(submode);
-	string payloadVal = sanitizeForLog(payload, 4096);
+	string payloadVal = escapeForLog(payload);
 
-	stringstream ss;
-	ss << "event=request-payload pid=" << getpid();
+	log->beginEvent("request-payload");
 	if (!remoteAddr.empty())
-		ss << " remote=\"" << remoteAddr << "\"";
+		log->addField("remote", remoteAddr);
 	if (!modeVal.empty())
-		ss << " mode=\"" << modeVal << "\"";
+		log->addField("mode", modeVal);
 	if (!subVal.empty())
-		ss << " sub=\"" << subVal << "\"";
-	ss << " data1=\"" << payloadVal << "\"";
+		log->addField("sub", subVal);
+	log->addField("data1", payloadVal);
+	log->endEvent();
+}
 
-	appendRequestLog(ss.str());
+static void logRequestTiming(CRequestLog* log, CStageTimer* timer)
+{
+	if ((log == NULL) || (timer == NULL))
+		return;
+
+	/* microseconds per stage, stages not entered are left out */
+	log->beginEvent("request-timing");
+	log->addField("id", timer->getRequestId(), false);
+	log->addField("total_us", timer->elapsed() / 1000);
+	for (int i = 0; i < CStageTimer::stageCount; i++) {
+		if (timer->getCalls(i) > 0)
+			log->addField(CStageTimer::stageName(i), timer->getDuration(i) / 1000);
+	}
+	log->endEvent();
 }
 
 void myExit(int val);
 
-CMtApi::CMtApi()
+/* initRequest=false: no request environment, for the benchmarks */
+CMtApi::CMtApi(bool initRequest/*=true*/)
 {
+	timer		= new CStageTimer();
 	cnet		= NULL;
+	reqLog		= NULL;
+	metrics		= NULL;
+	limiter		= NULL;
 	chtml		= NULL;
 	cjson		= NULL;
 	csql		= NULL;
+	ctemplate	= NULL;
+	workPool	= NULL;
 	g_debugMode	= false;
 	g_apiMode	= apiMode_unknown;
 	g_queryMode	= queryMode_None;
 	g_msgBoxText	= "";
 	indexMode	= false;
-	Init();
+	catalogMode	= false;
+	batchMode	= false;
+	metricsMode	= false;
+	dbBusy		= false;
+	cacheKey	= "";
+	if (initRequest)
+		Init();
 }
 
 string CMtApi::addTextMsgBox(bool clear/*=false*/)
 {
 	g_msgBoxText = base64encode(g_msgBoxText);
-	string html = readFile(g_dataRoot + "/template/msgbox.html");
-	html = str_replace("@@@MSGTXT@@@", (clear)?"":g_msgBoxText, html);
+	string html = templates()->render("msgbox.html", { { "MSGTXT", (clear)?"":g_msgBoxText } });
 	g_msgBoxText = "";
 	return html;
 }
 
+/* HTML pages, templates, worker threads and the database backend are set up by the routes that need them */
+CHtml* CMtApi::html()
+{
+	if (chtml == NULL)
+		chtml = new CHtml();
+	return chtml;
+}
+
+CDbBackend* CMtApi::db()
+{
+	if (csql == NULL)
+		csql = CDbBackend::create();
+	return csql;
+}
+
+CTemplate* CMtApi::templates()
+{
+	if (ctemplate == NULL)
+		ctemplate = new CTemplate();
+	return ctemplate;
+}
+
+CWorkPool* CMtApi::workers()
+{
+	if (workPool == NULL)
+		workPool = new CWorkPool();
+	return workPool;
+}
+
 void CMtApi::Init()
 {
+	timer->begin(CStageTimer::stageEnv);
+
 	/* read GET data */
 	string inData;
 	cnet = new CNet();
+	timer->setRequestId(cnet->getEnv("HTTP_X_REQUEST_ID"));
+	cnet->output->addHeader("X-Request-Id", timer->getRequestId());
 	cnet->readGetData(inData);
-	cnet->splitGetInput(inData, getData);
-	queryString_mode = cnet->getGetValue(getData, "mode");
+	getData.parse(move(inData));
+	queryString_mode = getData.get("mode");
+	queryString_submode = getData.get("sub");
 	const string modeLowerInit = str_tolower(queryString_mode);
 	if (modeLowerInit.empty() || strEqual(modeLowerInit, "index")) {
 		indexMode = true;
 	}
+	const string subLowerInit = str_tolower(queryString_submode);
+	catalogMode = (strEqual(modeLowerInit, "api") &&
+		       (strEqual(subLowerInit, "catalog") ||
+			strEqual(subLowerInit, "catalogpatch") ||
+			strEqual(subLowerInit, "cataloginfo")));
+	metricsMode = (strEqual(modeLowerInit, "api") && strEqual(subLowerInit, "metrics"));
 	string tmp_s = cnet->getEnv("SERVER_NAME");
 	g_debugMode = ((tmp_s.find(".debug.coolithek.") != string::npos) ||
 		       (tmp_s.find("coolithek.slknet.de") == 0) ||
@@ -251,10 +313,16 @@ void CMtApi::Init()
 		       (tmp_s.find("neutrino-mediathek.de") == 0) ||
 		       (tmp_s.find("www.neutrino-mediathek.de") == 0) ||
 		       (indexMode == true));
+	/* debug pages stay uncompressed, stderr is mixed into them */
+	if (!g_debugMode)
+		cnet->negotiateEncoding();
 	string cth = (g_debugMode) ? "text/html; charset=utf-8" : "application/json; charset=utf-8";
-	cnet->sendContentTypeHeader(cth);
+	cnet->output->setContentType(cth);
 //#ifdef SANITIZER
-	if (g_debugMode) {
+	/* catalog requests send their files with their own header, metrics are plain text */
+	if (g_debugMode && !catalogMode && !metricsMode) {
+		/* stderr goes into the page, so the header has to be out first */
+		cnet->output->sendHeader();
 		dup2(STDOUT_FILENO, STDERR_FILENO);
 	}
 //#endif
@@ -263,112 +331,164 @@ void CMtApi::Init()
 	string installRoot = getPathName(g_documentRoot);
 	g_dataRoot	= installRoot + "/data";
 	g_logRoot	= installRoot + "/log";
+	g_cacheRoot	= installRoot + "/cache";
+	checkCacheDir();
+	metrics		= new CMetrics(g_cacheRoot + "/metrics.shm");
 	g_progName	= PROGNAME;
 	g_progNameShort	= PROGNAMESHORT;
 	g_progCopyright	= COPYRIGHT;
 	g_progVersion	= "v" PROGVERSION;
 
-	chtml		= new CHtml();
 	cjson		= new CJson();
-	csql		= new CSql();
 
-	logRequestStart(cnet, queryString_mode);
+	reqLog = new CRequestLog();
+	reqLog->setFile(g_logRoot + "/mt-api.requests.log");
+	logRequestStart(reqLog, cnet, queryString_mode);
+
+	timer->end(CStageTimer::stageEnv);
+}
+
+/*
+ * Metrics, limits, stale responses and coalescing all live in the cache
+ * directory and are off without it. A missing one is created; when that
+ * fails the web server error log gets a note, once (marker in g_logRoot).
+ */
+void CMtApi::checkCacheDir()
+{
+	if ((mkdir(g_cacheRoot.c_str(), 0755) == 0) || (errno == EEXIST))
+		return;
+	int err = errno;
+	string marker = g_logRoot + "/mt-api.no-cache-dir";
+	int fd = open(marker.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if ((fd < 0) && (errno == EEXIST))
+		return;
+	if (fd >= 0)
+		close(fd);
+	cerr << PROGNAMESHORT << ": cannot create " << g_cacheRoot << " (" << strerror(err)
+	     << "), metrics, rate limits, stale responses and coalescing are disabled" << endl;
 }
 
 CMtApi::~CMtApi()
 {
+	/* the database slot is free once the work is done */
+	if (limiter != NULL)
+		delete limiter;
+	/* the response is out first, then the log is written */
+	if (cnet != NULL) {
+		timer->begin(CStageTimer::stageOutput);
+		cnet->output->send();
+		timer->end(CStageTimer::stageOutput);
+	}
+	if (metrics != NULL) {
+		metrics->countRequest(CMetrics::endpointIndex(str_tolower(queryString_mode), str_tolower(queryString_submode)));
+		metrics->recordRequest(timer, (csql != NULL) ? csql->getRowCount() : 0, (cnet != NULL) ? cnet->output->getBytesSent() : 0);
+	}
 	if (cnet != NULL)
 		delete cnet;
+	if (reqLog != NULL) {
+		logRequestTiming(reqLog, timer);
+		reqLog->flush();
+		delete reqLog;
+	}
 	if (chtml != NULL)
 		delete chtml;
 	if (cjson != NULL)
 		delete cjson;
 	if (csql != NULL)
 		delete csql;
+	if (ctemplate != NULL)
+		delete ctemplate;
+	if (workPool != NULL)
+		delete workPool;
+	if (metrics != NULL)
+		delete metrics;
+	delete timer;
 }
 
 int CMtApi::run(int, char**)
 {
 	if (indexMode) {
-		htmlOut << chtml->getIndexSite();
-		cout << chtml->tidyRepair(htmlOut.str(), 0) << endl;
+		htmlOut << html()->getIndexSite();
+		cnet->output->write(html()->tidyRepair(htmlOut.str(), 0) + "\n");
 		return 0;
 	}
 
-	csql->connectMysql();
+	if (metricsMode)
+		return runMetrics();
 
 	const string modeLower = str_tolower(queryString_mode);
 	if (strEqual(modeLower, "api")) {
-		queryString_submode = cnet->getGetValue(getData, "sub");
 		const string subLower = str_tolower(queryString_submode);
-		logRequestTarget(cnet, queryString_mode, queryString_submode);
-		if (strEqual(subLower, "info")) {
+		logRequestTarget(reqLog, cnet, queryString_mode, queryString_submode);
+		if (!admitRequest())
+			return 0;
+		if (catalogMode) {
+			return runCatalog(subLower);
+		}
+		else if (strEqual(subLower, "info")) {
 			g_queryMode = queryMode_Info;
 			if (!g_debugMode) {
 				progInfo_t pi;
 				cjson->resetProgInfoStruct(&pi);
-				csql->sqlGetProgInfo(&pi);
-				cout << cjson->progInfo2Json(&pi) << endl;
-				return 0;
+				bool ok = (!dbBusy && db()->sqlGetProgInfo(&pi));
+				cacheKey = queryKey(g_queryMode);
+				return sendResponse(ok, cjson->progInfo2Json(&pi));
 			}
 		}
 		else if (strEqual(subLower, "listlivestream")) {
 			g_queryMode = queryMode_listLivestreams;
 			if (!g_debugMode) {
 				vector<livestreams_t> ls;
-				csql->sqlListLiveStreams(ls);
-				cout << cjson->liveStreamList2Json(ls) << endl;
-				return 0;
+				bool ok = (!dbBusy && db()->sqlListLiveStreams(ls));
+				cacheKey = queryKey(g_queryMode);
+				return sendResponse(ok, cjson->liveStreamList2Json(ls));
 			}
 		}
 		else if (strEqual(subLower, "listchannels")) {
 			g_queryMode = queryMode_listChannels;
 			if (!g_debugMode) {
 				vector<channels_t> ch;
-				csql->sqlListChannels(ch);
-				cout << cjson->channelList2Json(ch) << endl;
-				return 0;
+				bool ok = (!dbBusy && db()->sqlListChannels(ch));
+				cacheKey = queryKey(g_queryMode);
+				return sendResponse(ok, cjson->channelList2Json(ch));
 			}
 		}
-		else {
-			/* read POST data */
-			string inData;
-			cnet->readPostData(inData);
-			if (!inData.empty()) {
-				cnet->splitPostInput(inData, postData);
-				if (!postData.empty())
-					inJsonData = cnet->getPostValue(postData, "data1");
-				if (!postData.empty() && !inJsonData.empty())
-					logRequestPayload(cnet, queryString_mode, queryString_submode, inJsonData);
+		else if (strEqual(subLower, "batch")) {
+			batchMode = true;
+			bool postOk = readPostJson();
+			if (!g_debugMode) {
+				if (!postOk)
+					return postError();
+				bool ok = !dbBusy;
+				string json = runBatch("", &ok);
+				return sendResponse(ok, json);
 			}
+		}
+		else {
+			bool postOk = readPostJson();
+			if (!g_debugMode && !postOk)
+				return postError();
 			if (inJsonData.empty())
-				inJsonData = readFile(g_dataRoot + "/template/test_1.json");
+				inJsonData = templates()->render("test_1.json");
 
 			if (!g_debugMode) {
-				bool parseIO = cjson->parsePostData(inJsonData);
-				if (parseIO) {
-					if (g_queryMode == queryMode_listVideos) {
-						cout << cjson->videoList2Json() << endl;
-					}
-				}
-				else {
-					string msg = (g_jsonError.empty()) ? "API Error" : g_jsonError;
-					cout << cjson->jsonErrMsg(msg) << endl;
-				}
+				string streamFormat = str_tolower(getData.get("stream"));
+				if (!streamFormat.empty())
+					return runStreamVideos(streamFormat);
 
-				return 0;
+				return runListVideos();
 			}
 		}
 	}
 	else if ((queryString_mode.find("page") == 3) && (queryString_mode.length() == 7)) {
 		/* 000page */
-		htmlOut << chtml->getErrorSite(atoi(queryString_mode.c_str()), "");
-		cout << chtml->tidyRepair(htmlOut.str(), 0) << endl;
+		htmlOut << html()->getErrorSite(atoi(queryString_mode.c_str()), "");
+		cnet->output->write(html()->tidyRepair(htmlOut.str(), 0) + "\n");
 		return 0;
 	}
 	else {
-		htmlOut << chtml->getErrorSite(404, queryString_mode);
-		cout << chtml->tidyRepair(htmlOut.str(), 0) << endl;
+		htmlOut << html()->getErrorSite(404, queryString_mode);
+		cnet->output->write(html()->tidyRepair(htmlOut.str(), 0) + "\n");
 		return 0;
 	}
 
@@ -380,34 +500,34 @@ int CMtApi::run(int, char**)
 		headerFlags |= CHtml::includeCopyR;
 		headerFlags |= CHtml::includeGenerator;
 		headerFlags |= CHtml::includeApplication;
-		htmlOut << chtml->getHtmlHeader("Coolithek API", headerFlags);
+		htmlOut << html()->getHtmlHeader("Coolithek API", headerFlags);
 
-		string mainBody = readFile(g_dataRoot + "/template/main-body.html");
 		inJsonData = cjson->styledJson(inJsonData);
-		if (g_queryMode < queryMode_beginPOSTmode)
-			mainBody = str_replace("@@@JSON_TEXTAREA@@@", "{}", mainBody);
-		else
-			mainBody = str_replace("@@@JSON_TEXTAREA@@@", inJsonData, mainBody);
-		htmlOut << mainBody;
+		htmlOut << templates()->render("main-body.html", { { "JSON_TEXTAREA", (g_queryMode < queryMode_beginPOSTmode) ? "{}" : inJsonData } });
 
-		if (g_queryMode == queryMode_Info) {
+		if (batchMode) {
+			string tmp_json = runBatch("  ");
+			tmp_json = cnet->decodeData(tmp_json);
+			htmlOut << cjson->formatJson(tmp_json) << endl;
+		}
+		else if (g_queryMode == queryMode_Info) {
 			progInfo_t pi;
 			cjson->resetProgInfoStruct(&pi);
-			csql->sqlGetProgInfo(&pi);
+			db()->sqlGetProgInfo(&pi);
 			string tmp_json = cjson->progInfo2Json(&pi, "  ");
 			tmp_json = cnet->decodeData(tmp_json);
 			htmlOut << cjson->formatJson(tmp_json) << endl;
 		}
 		else if (g_queryMode == queryMode_listLivestreams) {
 			vector<livestreams_t> ls;
-			csql->sqlListLiveStreams(ls);
+			db()->sqlListLiveStreams(ls);
 			string tmp_json = cjson->liveStreamList2Json(ls, "  ");
 			tmp_json = cnet->decodeData(tmp_json);
 			htmlOut << cjson->formatJson(tmp_json) << endl;
 		}
 		else if (g_queryMode == queryMode_listChannels) {
 			vector<channels_t> ch;
-			csql->sqlListChannels(ch);
+			db()->sqlListChannels(ch);
 			string tmp_json = cjson->channelList2Json(ch, "  ");
 			tmp_json = cnet->decodeData(tmp_json);
 			htmlOut << cjson->formatJson(tmp_json) << endl;
@@ -426,26 +546,331 @@ int CMtApi::run(int, char**)
 		if (!g_msgBoxText.empty())
 			htmlOut << addTextMsgBox();
 
-		htmlOut << chtml->getHtmlFooter(g_dataRoot + "/template/footer.html", "<hr style='width: 80%;'>") << endl;
+		htmlOut << html()->getTimingWaterfall(timer);
+
+		htmlOut << html()->getHtmlFooter("footer.html", "<hr style='width: 80%;'>") << endl;
 
 		/* Output data repaired by tidy */
-		cout << chtml->tidyRepair(htmlOut.str(), 0) << endl;
+		cnet->output->write(html()->tidyRepair(htmlOut.str(), 0) + "\n");
 	}
 	else {
 		string json = "{ \"error\": 1, \"head\": [], \"entry\": \"Unsupported parameter.\" }";
 //		json = cjson->styledJson(json);
 		json = cjson->styledJson(inJsonData);
-		cout << json << endl;
+		cnet->output->write(json + "\n");
+	}
+
+	return 0;
+}
+
+/*
+ * Rate limit per client address, then the cap on concurrent requests
+ * using the database. Catalog routes take their slot in CCatalog::update()
+ * only for the version check and build, sending the files needs none.
+ * Rejected requests get a short JSON error before any database work;
+ * JSON routes over the database cap go on with dbBusy set and try the
+ * stale response in sendResponse() first.
+ */
+bool CMtApi::admitRequest()
+{
+	limiter = new CLimiter(g_cacheRoot + "/limits.shm");
+
+	int status = 200;
+	string msg;
+	if (!limiter->allowClient(cnet->getEnv("REMOTE_ADDR"))) {
+		status = 429;
+		msg = "Too many requests, please retry later.";
+		metrics->countRejected(CMetrics::rejectRate);
+	}
+	else if (!catalogMode && !limiter->acquireDb()) {
+		status = 503;
+		msg = "Server busy, please retry later.";
+		metrics->countRejected(CMetrics::rejectBusy);
+		if (!g_debugMode && getData.get("stream").empty()) {
+			dbBusy = true;
+			return true;
+		}
+	}
+	if (status == 200)
+		return true;
+
+	cnet->output->setStatus(status);
+	cnet->output->addHeader("Retry-After", to_string(limiter->getRetryAfter()));
+	cnet->output->write(cjson->jsonErrMsg(msg) + "\n");
+	return false;
+}
+
+/*
+ * The query is the form field data1 or, with Content-Type
+ * application/json, the whole body. false: body rejected, the
+ * status is in cnet->getPostStatus(), the message in g_jsonError.
+ */
+bool CMtApi::readPostJson()
+{
+	CStageScope stageScope(timer, CStageTimer::stagePostRead);
+
+	/* read POST data */
+	string inData;
+	if (!cnet->readPostData(inData)) {
+		if (cnet->getPostStatus() == 413)
+			g_jsonError = "Request body too large (max. " + to_string(cnet->getPostMaxData()) + " bytes).";
+		else
+			g_jsonError = "Incomplete request body.";
+		g_msgBoxText = g_jsonError;
+		return false;
+	}
+	if (!inData.empty()) {
+		string contentType = str_tolower(cnet->getEnv("CONTENT_TYPE"));
+		if (contentType.compare(0, 16, "application/json") == 0)
+			inJsonData = move(inData);
+		else {
+			postData.parse(move(inData));
+			inJsonData = postData.get("data1");
+		}
+		if (!inJsonData.empty())
+			logRequestPayload(reqLog, cnet, queryString_mode, queryString_submode, inJsonData);
+	}
+	return true;
+}
+
+/* response to a rejected request body */
+int CMtApi::postError()
+{
+	cnet->output->setStatus(cnet->getPostStatus());
+	cnet->output->write(cjson->jsonErrMsg(g_jsonError) + "\n");
+	return 0;
+}
+
+/* queryOk: false on entry skips the database, only cacheKey is set */
+string CMtApi::runBatch(string indent/*=""*/, bool* queryOk/*=NULL*/)
+{
+	vector<batchRequest_t> br;
+	if (!cjson->parseBatch(inJsonData, br)) {
+		string msg = (g_jsonError.empty()) ? "API Error" : g_jsonError;
+		return cjson->jsonErrMsg(msg);
+	}
+	cacheKey = "batch";
+	for (size_t i = 0; i < br.size(); i++)
+		cacheKey += "\n" + queryKey(br[i].queryMode, &br[i].clv) + "\t" + br[i].error;
+	if ((queryOk != NULL) && !*queryOk)
+		return "";
+
+	if (!db()->sqlBatch(br)) {
+		if (queryOk != NULL)
+			*queryOk = false;
+		return cjson->jsonErrMsg("Database query failed.");
+	}
+
+	return cjson->batch2Json(br, indent);
+}
+
+/*
+ * The parsed query a response depends on, the same for requests that
+ * differ only in whitespace or field order.
+ */
+string CMtApi::queryKey(int queryMode, cmdListVideo_t* clv/*=NULL*/)
+{
+	string key = to_string(queryMode);
+	if ((queryMode == queryMode_listVideos) && (clv != NULL))
+		key += ":" + to_string(clv->timeMode) + ":" + to_string(clv->epoch) + ":" + to_string(clv->duration) + ":" +
+		       to_string(clv->limit) + ":" + to_string(clv->start) + ":" + to_string(static_cast<long long>(clv->refTime)) +
+		       ":" + clv->channel;
+	return key;
+}
+
+/* encoded: body in the content encoding of the output, empty: send body as it is */
+void CMtApi::writeBody(const string& body, const string& encoded)
+{
+	if (encoded.empty())
+		cnet->output->write(body);
+	else
+		cnet->output->writeEncoded(encoded);
+}
+
+/*
+ * A good response is sent and kept for the stale fallback, under
+ * cacheKey as set by the route (none: not kept). When the
+ * database failed, ran past the request deadline or was over its request
+ * cap, the last good response to the same query goes out instead, marked
+ * with X-Cache: stale and its Age. Without one the request gets json, or
+ * a 503 if the database was not even tried. Responses are kept in the
+ * content encoding they went out in; encoded: json in that encoding if
+ * the caller already has it.
+ */
+int CMtApi::sendResponse(bool ok, const string& json, const string* encoded/*=NULL*/)
+{
+	CResponseCache cache(g_cacheRoot + "/responses");
+	int enc = cnet->output->getEncoding();
+	if (ok) {
+		string body = json + "\n";
+		string encBody = (encoded != NULL) ? *encoded : cnet->output->encodeBody(body);
+		writeBody(body, encBody);
+		if (!cacheKey.empty())
+			cache.store(cacheKey, body, enc, encBody);
+		return 0;
+	}
+
+	string body;
+	bool bodyEncoded = false;
+	int age = 0;
+	bool hit = (!cacheKey.empty() && cache.load(cacheKey, enc, &body, &bodyEncoded, &age));
+	metrics->countCache(CMetrics::cacheResponse, hit);
+	if (hit) {
+		cnet->output->addHeader("X-Cache", "stale");
+		cnet->output->addHeader("Age", to_string(age));
+		writeBody(body, (bodyEncoded) ? body : "");
 	}
+	else if (dbBusy) {
+		cnet->output->setStatus(503);
+		cnet->output->addHeader("Retry-After", to_string(limiter->getRetryAfter()));
+		cnet->output->write(cjson->jsonErrMsg("Server busy, please retry later.") + "\n");
+	}
+	else
+		cnet->output->write(json + "\n");
+	return 0;
+}
+
+/*
+ * listVideos as one response. Identical queries running at the same
+ * time in other processes are coalesced: the first one asks the
+ * database, the others send its serialized result.
+ */
+int CMtApi::runListVideos()
+{
+	cmdListVideo_t clv;
+	if (!cjson->parsePostQuery(inJsonData, &clv)) {
+		string msg = (g_jsonError.empty()) ? "API Error" : g_jsonError;
+		cnet->output->write(cjson->jsonErrMsg(msg) + "\n");
+		return 0;
+	}
+	if (g_queryMode != queryMode_listVideos)
+		return 0;
+	cacheKey = queryKey(g_queryMode, &clv);
+	if (dbBusy)
+		return sendResponse(false, "");
+
+	CSingleFlight flight(g_cacheRoot + "/flight.shm", g_cacheRoot + "/flight");
+	if (!flight.join(CSingleFlight::hashKey(cacheKey))) {
+		string body;
+		bool bodyEncoded = false;
+		bool shared = flight.wait(db()->timeLeftMs(), cnet->output->getEncoding(), &body, &bodyEncoded);
+		metrics->countCache(CMetrics::cacheFlight, shared);
+		if (shared) {
+			writeBody(body, (bodyEncoded) ? body : "");
+			return 0;
+		}
+	}
+	else
+		metrics->countCache(CMetrics::cacheFlight, false);
+
+	listVideoHead_t lvh;
+	vector<listVideo_t> lv;
+	cjson->resetListVideoHeadStruct(&lvh);
+	bool ok = db()->sqlListVideo(&clv, &lvh, lv);
+	string json = cjson->videoList2Json(&lvh, lv);
+	string encoded = (ok) ? cnet->output->encodeBody(json + "\n") : "";
+	flight.finish(ok, json + "\n", cnet->output->getEncoding(), encoded);
+	return sendResponse(ok, json, &encoded);
+}
+
+/*
+ * listVideos, sent while the rows come in from the database.
+ * format "ndjson": one entry per line, the last line holds error and head.
+ * Otherwise: the regular JSON response, written piece by piece.
+ */
+int CMtApi::runStreamVideos(string format)
+{
+	cmdListVideo_t clv;
+	if (!cjson->parsePostQuery(inJsonData, &clv)) {
+		string msg = (g_jsonError.empty()) ? "API Error" : g_jsonError;
+		cnet->output->write(cjson->jsonErrMsg(msg) + "\n");
+		return 0;
+	}
+
+	bool ndjson = strEqual(format, "ndjson");
+	COutput* output = cnet->output;
+	if (ndjson)
+		output->setContentType("application/x-ndjson; charset=utf-8");
+	output->beginStream();
+	if (!ndjson)
+		output->write("{\"entry\":[");
+
+	listVideoHead_t lvh;
+	cjson->resetListVideoHeadStruct(&lvh);
+	bool first = true;
+	bool ok = db()->sqlStreamVideo(&clv, &lvh, [&](listVideo_t* lv) -> bool {
+		if (!ndjson && !first)
+			output->write(",");
+		timer->begin(CStageTimer::stageSerialize);
+		string entry = cjson->json2String(cjson->videoEntry2Json(lv));
+		timer->end(CStageTimer::stageSerialize);
+		output->write(entry);
+		if (ndjson)
+			output->write("\n");
+		first = false;
+		return true;
+	});
+
+	string head = "\"error\":" + string((ok) ? "0" : "1") + ",\"head\":" + cjson->json2String(cjson->videoListHead2Json(&lvh));
+	if (ndjson)
+		output->write("{" + head + "}\n");
+	else
+		output->write("]," + head + "}\n");
 
 	return 0;
 }
 
+int CMtApi::runMetrics()
+{
+	cnet->output->setContentType("text/plain; version=0.0.4; charset=utf-8");
+	cnet->output->write(metrics->metrics2Text());
+	return 0;
+}
+
+int CMtApi::runCatalog(string subLower)
+{
+	/*
+	 * The export reads the whole video table and takes far longer than a
+	 * request deadline; the MariaDB timeouts are fixed when connecting.
+	 */
+	db()->setDeadline(0);
+	CCatalog catalog;
+	/* update() takes a database slot only for the version check and a build */
+	bool ok = catalog.update();
+	if (!ok && catalog.isBusy()) {
+		metrics->countRejected(CMetrics::rejectBusy);
+		cnet->output->setStatus(503);
+		cnet->output->addHeader("Retry-After", to_string(limiter->getRetryAfter()));
+		cnet->output->write(cjson->jsonErrMsg(g_jsonError) + "\n");
+		return 0;
+	}
+	if (ok) {
+		if (strEqual(subLower, "catalog")) {
+			ok = catalog.sendCatalog();
+		}
+		else if (strEqual(subLower, "catalogpatch")) {
+			string from = getData.get("from");
+			ok = catalog.sendPatch(atoll(from.c_str()));
+		}
+		else {
+			cnet->output->write(catalog.catalogInfo2Json() + "\n");
+			return 0;
+		}
+	}
+
+	if (!ok) {
+		string msg = (g_jsonError.empty()) ? "API Error" : g_jsonError;
+		cnet->output->write(cjson->jsonErrMsg(msg) + "\n");
+	}
+	return 0;
+}
+
 void myExit(int val)
 {
 	exit(val);
 }
 
+#ifndef MT_API_NO_MAIN
 int main(int argc, char *argv[])
 {
 	g_mainInstance = NULL;
@@ -457,3 +882,4 @@ int main(int argc, char *argv[])
 
 	return ret;
 }
+#endif // MT_API_NO_MAIN
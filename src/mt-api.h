@@ -32,13 +32,20 @@
 #include <string>
 
 #include "types.h"
+#include "formdata.h"
 
 using namespace std;
 
 class CNet;
+class CRequestLog;
+class CStageTimer;
+class CMetrics;
 class CHtml;
 class CJson;
-class CSql;
+class CDbBackend;
+class CTemplate;
+class CLimiter;
+class CWorkPool;
 
 class CMtApi
 {
@@ -47,23 +54,50 @@ class CMtApi
 		string queryString_mode;
 		string queryString_submode;
 		bool indexMode;
+		bool catalogMode;
+		bool batchMode;
+		bool metricsMode;
+		bool dbBusy;
+		string cacheKey;
 
 		void Init();
+		void checkCacheDir();
 		string addTextMsgBox(bool clear=false);
+		bool readPostJson();
+		bool admitRequest();
+		int postError();
+		static string queryKey(int queryMode, cmdListVideo_t* clv=NULL);
+		void writeBody(const string& body, const string& encoded);
+		int sendResponse(bool ok, const string& json, const string* encoded=NULL);
+		int runListVideos();
+		string runBatch(string indent="", bool* queryOk=NULL);
+		int runStreamVideos(string format);
+		int runCatalog(string subLower);
+		int runMetrics();
 
 	public:
 		CNet* cnet;
+		CRequestLog* reqLog;
+		CStageTimer* timer;
+		CMetrics* metrics;
+		CLimiter* limiter;
 		CHtml* chtml;
 		CJson* cjson;
-		CSql* csql;
+		CDbBackend* csql;
+		CTemplate* ctemplate;
+		CWorkPool* workPool;
 		stringstream htmlOut;
 		string inJsonData;
 
-		vector<string> getData;
-		vector<string> postData;
+		CFormData getData;
+		CFormData postData;
 
-		CMtApi();
+		CMtApi(bool initRequest=true);
 		~CMtApi();
+		CHtml* html();
+		CDbBackend* db();
+		CTemplate* templates();
+		CWorkPool* workers();
 		int run(int argc, char *argv[]);
 
 };
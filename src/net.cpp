@@ -2,7 +2,6 @@
 #include <sys/types.h>
 #include <sys/time.h>
 #include <sys/stat.h>
-#include <fcntl.h>
 #include <libgen.h>
 #include <errno.h>
 
@@ -13,7 +12,13 @@
 #include <iomanip>
 #include <cctype>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "common/helpers.h"
+#include "compress.h"
+#include "output.h"
 #include "net.h"
 
 CNet::CNet()
@@ -23,19 +28,25 @@ CNet::CNet()
 
 void CNet::Init()
 {
-	postMaxData = 1024 * 32; /* 32KB */
+	/* MT_API_POST_MAX_BYTES: largest accepted request body */
+	const char* maxEnv = getenv("MT_API_POST_MAX_BYTES");
+	postMaxData = (maxEnv && (atol(maxEnv) > 0)) ? static_cast<uint32_t>(atol(maxEnv)) : 1024 * 32; /* 32KB */
+	postStatus = 200;
+	output = new COutput(new CFdSink(STDOUT_FILENO));
 }
 
 CNet::~CNet()
 {
+	output->send();
+	delete output;
 }
 
-void CNet::sendContentTypeHeader(string type/*="text/html; charset=utf-8"*/)
+/* MT_API_COMPRESSION=0 disables response compression */
+void CNet::negotiateEncoding()
 {
-	cout << "Content-Type: " << type << "\n\n";
-#ifdef SANITIZER
-	cerr << "Content-Type: " << type << "\n\n";
-#endif
+	if (strEqual(getEnv("MT_API_COMPRESSION"), "0"))
+		return;
+	output->setEncoding(CEncoder::negotiate(getEnv("HTTP_ACCEPT_ENCODING")), true);
 }
 
 string CNet::readGetData(string &data)
@@ -48,104 +59,214 @@ string CNet::readGetData(string &data)
 	return data;
 }
 
-bool CNet::splitGetInput(string get, vector<string>& get_v)
+/*
+ * Request body of CONTENT_LENGTH bytes, read with one loop into a buffer
+ * of that size. Without CONTENT_LENGTH stdin is read up to EOF. Bodies
+ * larger than postMaxData are rejected before reading (413), a short or
+ * unreadable body is 400; getPostStatus() tells which.
+ */
+bool CNet::readPostData(string &data)
 {
-	return splitPostInput(get, get_v);
-}
+	data = "";
+	postStatus = 200;
 
-string CNet::getGetValue(vector<string>& get_v, string key)
-{
-	return getPostValue(get_v, key);
-}
+	string lenEnv = getEnv("CONTENT_LENGTH");
+	bool haveLength = !lenEnv.empty();
+	/* no length: test whether stdin is associated with a terminal */
+	if (!haveLength && isatty(STDIN_FILENO))
+		return true;
 
-string CNet::readPostData(string &data)
-{
-	/* test whether stdin is associated with a terminal */
-	if (isatty(fileno(stdin))) {
-		data = "";
-		return data;
+	size_t length = postMaxData + 1;
+	if (haveLength) {
+		char* end = NULL;
+		errno = 0;
+		unsigned long long val = strtoull(lenEnv.c_str(), &end, 10);
+		if ((errno != 0) || (end == lenEnv.c_str()) || (*end != '\0') || (lenEnv[0] == '-')) {
+			postStatus = 400;
+			return false;
+		}
+		if (val > postMaxData) {
+			postStatus = 413;
+			return false;
+		}
+		length = static_cast<size_t>(val);
 	}
 
-	/* read POST data */
-	data = "";
-	for (string line; getline(cin, line);) {
-		if ((data.length() + line.length()) > postMaxData) {
-			data += line;
-			data = data.substr(0, postMaxData-1);
+	data.resize(length);
+	size_t got = 0;
+	while (got < length) {
+		ssize_t n = read(STDIN_FILENO, &data[got], length - got);
+		if ((n < 0) && (errno == EINTR))
+			continue;
+		if (n <= 0)
 			break;
-		}
-		data += line;
+		got += n;
 	}
+	data.resize(got);
 
-	return data;
+	if (!haveLength && (got > postMaxData)) {
+		data = "";
+		postStatus = 413;
+		return false;
+	}
+	if (haveLength && (got < length)) {
+		data = "";
+		postStatus = 400;
+		return false;
+	}
+	return true;
 }
 
-bool CNet::splitPostInput(string post, vector<string>& post_v)
+/*
+ * Percent coding: the SSE2 loops test 16 bytes per step and copy runs
+ * without special characters in one piece, the scalar code handles
+ * only the bytes that change. Results are the same as the byte-wise
+ * versions (alnum and "-_.~" kept, ' ' <=> '+', %XX upper case).
+ */
+static const char hexDigits[] = "0123456789ABCDEF";
+
+static int hexValue(unsigned char ch)
 {
-	stringstream ss;
-	ss << post;
-	string item;
-	while (getline(ss, item, '&'))
-		post_v.push_back(item);
+	if ((ch >= '0') && (ch <= '9')) return ch - '0';
+	if ((ch >= 'a') && (ch <= 'f')) return 10 + (ch - 'a');
+	if ((ch >= 'A') && (ch <= 'F')) return 10 + (ch - 'A');
+	return -1;
+}
 
-	return true;
+static bool isUnreserved(unsigned char c)
+{
+	return (((c >= '0') && (c <= '9')) || ((c >= 'A') && (c <= 'Z')) || ((c >= 'a') && (c <= 'z')) ||
+		(c == '-') || (c == '_') || (c == '.') || (c == '~'));
+}
+
+#ifdef __SSE2__
+/* bitmask of the bytes in [lo, hi], bytes >= 0x80 never match */
+static inline __m128i rangeMask(__m128i v, char lo, char hi)
+{
+	return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
 }
+#endif
 
-string CNet::getPostValue(vector<string>& post_v, string key)
+/* length of the run from data[0] that needs no encoding */
+static size_t unreservedSpan(const char* data, size_t len)
 {
-	for (size_t i = 0; i < post_v.size(); i++) {
-		vector<string> v = split(post_v[i], '=');
-		if (!v.empty() && (v[0] == key) && (!(v[1]).empty()))
-			return decodeData(v[1]);
+	size_t i = 0;
+#ifdef __SSE2__
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		__m128i ok = _mm_or_si128(rangeMask(v, '0', '9'), _mm_or_si128(rangeMask(v, 'A', 'Z'), rangeMask(v, 'a', 'z')));
+		ok = _mm_or_si128(ok, _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('-')), _mm_cmpeq_epi8(v, _mm_set1_epi8('_'))));
+		ok = _mm_or_si128(ok, _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('.')), _mm_cmpeq_epi8(v, _mm_set1_epi8('~'))));
+		unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(ok));
+		if (mask != 0xFFFF)
+			return i + __builtin_ctz(~mask);
 	}
-	return "";
+#endif
+	while ((i < len) && isUnreserved(data[i]))
+		i++;
+	return i;
 }
 
-string CNet::encodeData(string data)
+/* length of the run from data[0] without '%' and '+' */
+static size_t plainSpan(const char* data, size_t len)
 {
-	std::ostringstream encoded;
-	encoded << std::hex << std::uppercase;
-	for (unsigned char c : data) {
-		if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
-			encoded << c;
-		} else if (c == ' ') {
-			encoded << '+';
-		} else {
-			encoded << '%' << std::setw(2) << std::setfill('0') << static_cast<int>(c);
-		}
+	size_t i = 0;
+#ifdef __SSE2__
+	const __m128i pct = _mm_set1_epi8('%');
+	const __m128i plus = _mm_set1_epi8('+');
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, pct), _mm_cmpeq_epi8(v, plus))));
+		if (mask != 0)
+			return i + __builtin_ctz(mask);
 	}
-	return encoded.str();
+#endif
+	while ((i < len) && (data[i] != '%') && (data[i] != '+'))
+		i++;
+	return i;
 }
 
-string CNet::decodeData(string data)
+/* decodes src into dst (dst == src allowed, the output is never longer), returns the length */
+static size_t decodeBuffer(const char* src, size_t len, char* dst)
 {
-	std::string decoded;
-	decoded.reserve(data.size());
-	for (size_t i = 0; i < data.size(); ++i) {
-		char c = data[i];
+	size_t in = 0, out = 0;
+	while (in < len) {
+		size_t span = plainSpan(src + in, len - in);
+		if ((span > 0) && (dst + out != src + in))
+			memmove(dst + out, src + in, span);
+		in += span;
+		out += span;
+		if (in >= len)
+			break;
+
+		unsigned char c = src[in];
 		if (c == '+') {
-			decoded.push_back(' ');
-		} else if (c == '%' && (i + 2) < data.size()) {
-			char hi = data[i + 1];
-			char lo = data[i + 2];
-			if (std::isxdigit(hi) && std::isxdigit(lo)) {
-				auto hexValue = [](char ch) -> int {
-					if (ch >= '0' && ch <= '9') return ch - '0';
-					if (ch >= 'a' && ch <= 'f') return 10 + (ch - 'a');
-					if (ch >= 'A' && ch <= 'F') return 10 + (ch - 'A');
-					return 0;
-				};
-				int value = (hexValue(hi) << 4) | hexValue(lo);
-				decoded.push_back(static_cast<char>(value));
-				i += 2;
-			} else {
-				decoded.push_back(c);
-			}
-		} else {
-			decoded.push_back(c);
+			dst[out++] = ' ';
+			in++;
+			continue;
+		}
+		int hi = ((in + 2) < len) ? hexValue(src[in + 1]) : -1;
+		int lo = (hi >= 0) ? hexValue(src[in + 2]) : -1;
+		if (lo >= 0) {
+			dst[out++] = static_cast<char>((hi << 4) | lo);
+			in += 3;
+		}
+		else {
+			dst[out++] = c;
+			in++;
+		}
+	}
+	return out;
+}
+
+string CNet::encodeData(string data)
+{
+	const char* src = data.data();
+	size_t len = data.length();
+	size_t first = unreservedSpan(src, len);
+	if (first == len)
+		return data;
+
+	string encoded;
+	encoded.resize(first + (len - first) * 3);
+	char* dst = &encoded[0];
+	memcpy(dst, src, first);
+	size_t out = first;
+	size_t in = first;
+	while (in < len) {
+		unsigned char c = src[in++];
+		if (c == ' ')
+			dst[out++] = '+';
+		else {
+			dst[out++] = '%';
+			dst[out++] = hexDigits[c >> 4];
+			dst[out++] = hexDigits[c & 0x0F];
 		}
+		size_t span = unreservedSpan(src + in, len - in);
+		memcpy(dst + out, src + in, span);
+		in += span;
+		out += span;
 	}
-	return decoded;
+	encoded.resize(out);
+	return encoded;
+}
+
+/* in place, the buffer of data is reused */
+string CNet::decodeData(string data)
+{
+	size_t len = data.length();
+	if (plainSpan(data.data(), len) == len)
+		return data;
+	data.resize(decodeBuffer(data.data(), len, &data[0]));
+	return data;
+}
+
+/* appends the percent-decoded data to out */
+void CNet::decodeData(const char* data, size_t len, string& out)
+{
+	size_t old = out.length();
+	out.resize(old + len);
+	out.resize(old + decodeBuffer(data, len, &out[old]));
 }
 
 /*
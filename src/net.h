@@ -12,32 +12,34 @@
 
 using namespace std;
 
+class COutput;
+
 class CNet
 {
 	private:
 		uint32_t postMaxData;
+		int postStatus;
 		
 		void Init();
 
 	public:
+		COutput* output;
+
 		CNet();
 		~CNet();
 
-		void sendContentTypeHeader(string type="text/html; charset=utf-8");
+		void negotiateEncoding();
 
 		string readGetData(string &data);
-		bool splitGetInput(string get, vector<string>& get_v);
-		string getGetValue(vector<string>& get_v, string key);
-
-		string readPostData(string &data);
-		bool splitPostInput(string post, vector<string>& post_v);
-		string getPostValue(vector<string>& post_v, string key);
+		bool readPostData(string &data);
+		int getPostStatus() { return postStatus; };
 		void setPostMaxData(uint32_t val) { postMaxData = val; };
 		uint32_t getPostMaxData() { return postMaxData; };
 
 		string getEnv(string key);
 		string encodeData(string data);
 		string decodeData(string data);
+		static void decodeData(const char* data, size_t len, string& out);
 };
 
 
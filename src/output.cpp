@@ -0,0 +1,279 @@
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include <string>
+
+#include "common/helpers.h"
+#include "compress.h"
+#include "output.h"
+
+/* send [offset, size) of fd */
+bool COutSink::sendFile(int fd, off_t offset, off_t size)
+{
+	char buf[64*1024];
+	while (offset < size) {
+		ssize_t ret = pread(fd, buf, sizeof(buf), offset);
+		if ((ret < 0) && (errno == EINTR))
+			continue;
+		if (ret <= 0)
+			return false;
+		struct iovec iov = { buf, static_cast<size_t>(ret) };
+		if (!writeVec(&iov, 1))
+			return false;
+		offset += ret;
+	}
+	return true;
+}
+
+bool CFdSink::writeVec(const struct iovec* iov, int count)
+{
+	struct iovec vec[8];
+	if (count > 8)
+		return false;
+	memcpy(vec, iov, count * sizeof(struct iovec));
+
+	struct iovec* v = vec;
+	while (count > 0) {
+		ssize_t ret = writev(fd, v, count);
+		if ((ret < 0) && (errno == EINTR))
+			continue;
+		if (ret < 0)
+			return false;
+		/* partial write, skip what is out already */
+		size_t done = static_cast<size_t>(ret);
+		while ((count > 0) && (done >= v->iov_len)) {
+			done -= v->iov_len;
+			v++;
+			count--;
+		}
+		if (count > 0) {
+			v->iov_base = static_cast<char*>(v->iov_base) + done;
+			v->iov_len -= done;
+		}
+	}
+	return true;
+}
+
+bool CFdSink::sendFile(int inFd, off_t offset, off_t size)
+{
+	/* let the kernel copy the file, fall back to read/write for outputs without sendfile support */
+	while (offset < size) {
+		ssize_t ret = sendfile(fd, inFd, &offset, size - offset);
+		if ((ret < 0) && (errno == EINTR))
+			continue;
+		if (ret <= 0)
+			break;
+	}
+	if (offset >= size)
+		return true;
+
+	return COutSink::sendFile(inFd, offset, size);
+}
+
+/* ---------------------------------------------------------------------- */
+
+COutput::COutput(COutSink* sink_)
+{
+	sink			= sink_;
+	status			= 200;
+	contentType		= "text/html; charset=utf-8";
+	extraHeader		= "";
+	encoding		= CEncoder::encIdentity;
+	encodingNegotiated	= false;
+	bodyEncoded		= false;
+	headerSent		= false;
+	sent			= false;
+	streaming		= false;
+	streamEncoder		= NULL;
+	bytesSent		= 0;
+}
+
+COutput::~COutput()
+{
+	if (streamEncoder != NULL)
+		delete streamEncoder;
+	delete sink;
+}
+
+const char* COutput::statusText(int code)
+{
+	switch (code) {
+		case 200: return "OK";
+		case 304: return "Not Modified";
+		case 400: return "Bad Request";
+		case 403: return "Forbidden";
+		case 404: return "Not Found";
+		case 413: return "Payload Too Large";
+		case 429: return "Too Many Requests";
+		case 500: return "Internal Server Error";
+		case 503: return "Service Unavailable";
+		case 504: return "Gateway Timeout";
+		default:  return "Unknown";
+	}
+}
+
+void COutput::setEncoding(int enc, bool negotiated)
+{
+	encoding = enc;
+	encodingNegotiated = negotiated;
+}
+
+/*
+ * data in the negotiated content encoding, empty when it goes out as is.
+ * Lets callers keep the encoded form (response caches) and hand it to
+ * writeEncoded() later instead of compressing the same body again.
+ */
+string COutput::encodeBody(const string& data)
+{
+	/* small bodies do not get smaller by compressing them */
+	if ((encoding == CEncoder::encIdentity) || (data.length() < minCompressSize))
+		return "";
+	return CEncoder::encode(encoding, data);
+}
+
+void COutput::addHeader(string name, string value)
+{
+	extraHeader += name + ": " + value + "\n";
+}
+
+/* contentLength < 0: length unknown, the body is streamed */
+string COutput::buildHeader(int64_t contentLength, int enc)
+{
+	string eol = "\n";
+	string ret;
+	ret.reserve(256);
+	if (status != 200)
+		ret += "Status: " + to_string(status) + " " + statusText(status) + eol;
+	ret += "Content-Type: " + contentType + eol;
+	if (enc != CEncoder::encIdentity)
+		ret += "Content-Encoding: " + string(CEncoder::encodingName(enc)) + eol;
+	if (encodingNegotiated)
+		ret += "Vary: Accept-Encoding" + eol;
+	if (contentLength >= 0)
+		ret += "Content-Length: " + to_string(static_cast<long long>(contentLength)) + eol;
+	ret += extraHeader;
+	ret += eol;
+	return ret;
+}
+
+/*
+ * Send the header now and the body in pieces as it is written.
+ * With CGI the web server takes care of the chunked transfer encoding.
+ */
+bool COutput::beginStream()
+{
+	if (headerSent)
+		return false;
+	headerSent = true;
+	streaming = true;
+
+	int enc = encoding;
+	if (enc != CEncoder::encIdentity) {
+		streamEncoder = new CEncoder(enc);
+		enc = streamEncoder->getEncoding();
+	}
+
+	string header = buildHeader(-1, enc);
+	struct iovec iov = { const_cast<char*>(header.data()), header.length() };
+	return sink->writeVec(&iov, 1);
+}
+
+bool COutput::writePiece(const string& data)
+{
+	if (data.empty())
+		return true;
+	struct iovec iov = { const_cast<char*>(data.data()), data.length() };
+	bytesSent += data.length();
+	return sink->writeVec(&iov, 1);
+}
+
+/* Send what was written so far, last: finish the stream */
+bool COutput::flushStream(bool last/*=false*/)
+{
+	if (!streaming)
+		return false;
+
+	bool ret = true;
+	if (streamEncoder != NULL) {
+		string out;
+		ret = streamEncoder->write(body.data(), body.length(), out);
+		ret = ret && ((last) ? streamEncoder->finish(out) : streamEncoder->flush(out));
+		ret = ret && writePiece(out);
+	}
+	else {
+		ret = writePiece(body);
+	}
+	body.clear();
+
+	return ret;
+}
+
+/*
+ * Send the header right away, without Content-Length and uncompressed.
+ * Used where other output (stderr in debug mode) is mixed into the body.
+ */
+bool COutput::sendHeader()
+{
+	encoding = CEncoder::encIdentity;
+	return beginStream();
+}
+
+bool COutput::send()
+{
+	if (sent)
+		return true;
+	sent = true;
+
+	if (streaming)
+		return flushStream(true);
+
+	int enc = (bodyEncoded) ? encoding : CEncoder::encIdentity;
+	string encoded;
+	if (!bodyEncoded) {
+		encoded = encodeBody(body);
+		if (!encoded.empty())
+			enc = encoding;
+	}
+	const string& payload = (!encoded.empty()) ? encoded : body;
+	headerSent = true;
+
+	string header = buildHeader(payload.length(), enc);
+	struct iovec iov[2];
+	iov[0].iov_base = const_cast<char*>(header.data());
+	iov[0].iov_len  = header.length();
+	iov[1].iov_base = const_cast<char*>(payload.data());
+	iov[1].iov_len  = payload.length();
+	bytesSent += payload.length();
+	return sink->writeVec(iov, 2);
+}
+
+bool COutput::sendFile(string file)
+{
+	if (sent || headerSent)
+		return false;
+
+	int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return false;
+	}
+	sent = true;
+	headerSent = true;
+
+	/* files are stored in their final form, no content encoding */
+	string header = buildHeader(st.st_size, CEncoder::encIdentity);
+	struct iovec iov = { const_cast<char*>(header.data()), header.length() };
+	bool ret = sink->writeVec(&iov, 1) && sink->sendFile(fd, 0, st.st_size);
+	if (ret)
+		bytesSent += st.st_size;
+	close(fd);
+
+	return ret;
+}
@@ -0,0 +1,99 @@
+
+#ifndef __OUTPUT_H__
+#define __OUTPUT_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <string>
+
+using namespace std;
+
+class CEncoder;
+
+/* Where a response goes, CGI stdout in mt-api */
+class COutSink
+{
+	public:
+		virtual ~COutSink() {};
+		virtual bool writeVec(const struct iovec* iov, int count) = 0;
+		virtual bool sendFile(int fd, off_t offset, off_t size);
+};
+
+class CFdSink : public COutSink
+{
+	private:
+		int fd;
+
+	public:
+		CFdSink(int fd_) { fd = fd_; };
+		virtual bool writeVec(const struct iovec* iov, int count);
+		virtual bool sendFile(int inFd, off_t offset, off_t size);
+};
+
+/*
+ * Collects header and body of one response and sends both with
+ * a single writev, including Content-Length.
+ * Streamed responses (beginStream) go out in pieces of streamChunkSize,
+ * without Content-Length.
+ */
+class COutput
+{
+	private:
+		COutSink* sink;
+		int status;
+		string contentType;
+		string extraHeader;
+		int encoding;
+		bool encodingNegotiated;
+		string body;
+		bool bodyEncoded;
+		bool headerSent;
+		bool sent;
+		bool streaming;
+		CEncoder* streamEncoder;
+		uint64_t bytesSent;
+
+		string buildHeader(int64_t contentLength, int enc);
+		bool writePiece(const string& data);
+
+	public:
+		enum {
+			minCompressSize = 256,
+			streamChunkSize = 16*1024
+		};
+
+		COutput(COutSink* sink_);
+		~COutput();
+
+		static const char* statusText(int code);
+
+		void setStatus(int code) { status = code; };
+		void setContentType(string type) { contentType = type; };
+		void setEncoding(int enc, bool negotiated);
+		int getEncoding() { return encoding; };
+		string encodeBody(const string& data);
+		void writeEncoded(const string& data) { body = data; bodyEncoded = true; };
+		void addHeader(string name, string value);
+		void write(const string& data) { body += data; if (streaming && (body.length() >= streamChunkSize)) flushStream(); };
+		void write(const char* data, size_t len) { body.append(data, len); if (streaming && (body.length() >= streamChunkSize)) flushStream(); };
+		size_t size() { return body.length(); };
+		void clear() { body.clear(); bodyEncoded = false; };
+		bool isSent() { return sent; };
+		bool isStreaming() { return streaming; };
+		uint64_t getBytesSent() { return bytesSent; };
+
+		bool beginStream();
+		bool flushStream(bool last=false);
+		bool sendHeader();
+		bool send();
+		bool sendFile(string file);
+};
+
+
+#endif // __OUTPUT_H__
@@ -0,0 +1,101 @@
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include <string>
+
+#include "reqlog.h"
+
+CRequestLog::CRequestLog()
+{
+	len	= 0;
+	tsTime	= 0;
+	ts[0]	= '\0';
+}
+
+CRequestLog::~CRequestLog()
+{
+	flush();
+}
+
+void CRequestLog::append(const char* data, size_t dataLen)
+{
+	/* keep one byte for the closing newline, cut what does not fit */
+	size_t space = bufSize - 1 - len;
+	if (dataLen > space)
+		dataLen = space;
+	memcpy(buf + len, data, dataLen);
+	len += dataLen;
+}
+
+bool CRequestLog::appendFile(string file, const char* data, size_t dataLen)
+{
+	if (file.empty())
+		return false;
+
+	int fd = open(file.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return false;
+
+	/* one write, O_APPEND keeps concurrent writers from interleaving */
+	ssize_t ret;
+	do {
+		ret = write(fd, data, dataLen);
+	} while ((ret < 0) && (errno == EINTR));
+	close(fd);
+
+	return (ret == static_cast<ssize_t>(dataLen));
+}
+
+void CRequestLog::beginEvent(const char* event)
+{
+	time_t now = time(NULL);
+	if (now != tsTime) {
+		struct tm tmNow;
+		if (localtime_r(&now, &tmNow) != NULL)
+			strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S%z", &tmNow);
+		else
+			snprintf(ts, sizeof(ts), "%lld", static_cast<long long>(now));
+		tsTime = now;
+	}
+
+	char tmp[128];
+	int n = snprintf(tmp, sizeof(tmp), "[%s] event=%s pid=%d", ts, event, static_cast<int>(getpid()));
+	append(tmp, min(static_cast<size_t>(n), sizeof(tmp) - 1));
+}
+
+void CRequestLog::addField(const char* key, const string& value, bool quote/*=true*/)
+{
+	append(" ", 1);
+	append(key, strlen(key));
+	append((quote) ? "=\"" : "=", (quote) ? 2 : 1);
+	append(value.data(), value.length());
+	if (quote)
+		append("\"", 1);
+}
+
+void CRequestLog::addField(const char* key, long long value)
+{
+	char tmp[32];
+	int n = snprintf(tmp, sizeof(tmp), "%lld", value);
+	addField(key, string(tmp, n), false);
+}
+
+void CRequestLog::endEvent()
+{
+	/* append() always leaves room for this */
+	buf[len++] = '\n';
+}
+
+bool CRequestLog::flush()
+{
+	if (len == 0)
+		return true;
+
+	bool ret = appendFile(logFile, buf, len);
+	len = 0;
+
+	return ret;
+}
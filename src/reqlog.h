@@ -0,0 +1,50 @@
+
+#ifndef __REQLOG_H__
+#define __REQLOG_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <string>
+
+using namespace std;
+
+/*
+ * Request log: all events of one request are formatted into a
+ * preallocated buffer and appended with a single O_APPEND write.
+ */
+class CRequestLog
+{
+	private:
+		enum {
+			bufSize = 16*1024
+		};
+
+		string logFile;
+		char buf[bufSize];
+		size_t len;
+		time_t tsTime;
+		char ts[32];
+
+		void append(const char* data, size_t dataLen);
+		static bool appendFile(string file, const char* data, size_t dataLen);
+
+	public:
+		CRequestLog();
+		~CRequestLog();
+
+		void setFile(string file) { logFile = file; };
+
+		void beginEvent(const char* event);
+		void addField(const char* key, const string& value, bool quote=true);
+		void addField(const char* key, long long value);
+		void endEvent();
+		bool flush();
+};
+
+
+#endif // __REQLOG_H__
@@ -0,0 +1,158 @@
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <time.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "common/helpers.h"
+#include "compress.h"
+#include "respcache.h"
+
+CResponseCache::CResponseCache(string cacheDir)
+{
+	dir = cacheDir;
+
+	const char* ageEnv = getenv("MT_API_STALE_MAX_AGE");
+	maxAge = (ageEnv && *ageEnv) ? atoi(ageEnv) : 86400;
+	const char* filesEnv = getenv("MT_API_STALE_MAX_FILES");
+	int files = (filesEnv && *filesEnv) ? atoi(filesEnv) : 2000;
+	maxFiles = static_cast<size_t>(max(files, 1));
+}
+
+/* FNV-1a of the key as file name, the encoding as suffix */
+string CResponseCache::keyFile(const string& key, int enc)
+{
+	uint64_t h = 14695981039346656037ULL;
+	for (size_t i = 0; i < key.length(); i++) {
+		h ^= static_cast<unsigned char>(key[i]);
+		h *= 1099511628211ULL;
+	}
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.json", static_cast<unsigned long long>(h));
+	string file = dir + "/" + name;
+	if (enc != CEncoder::encIdentity)
+		file += string(".") + CEncoder::encodingName(enc);
+	return file;
+}
+
+/* written at most once per refreshInterval, under a temporary name first */
+bool CResponseCache::writeFile(const string& file, const string& data)
+{
+	struct stat st;
+	if ((stat(file.c_str(), &st) == 0) && (time(NULL) - st.st_mtime < refreshInterval))
+		return true;
+
+	string tmpFile = file + "." + to_string(getpid()) + ".tmp";
+	ofstream out(tmpFile.c_str(), ios::trunc | ios::binary);
+	out << data;
+	out.close();
+	if (!out.good() || (rename(tmpFile.c_str(), file.c_str()) != 0)) {
+		unlink(tmpFile.c_str());
+		return false;
+	}
+	return true;
+}
+
+/* body: as sent, including the final newline; encoded: body in enc, empty if not sent encoded */
+bool CResponseCache::store(const string& key, const string& body, int enc, const string& encoded)
+{
+	if ((maxAge <= 0) || body.empty())
+		return false;
+
+	string file = keyFile(key, CEncoder::encIdentity);
+	if (!file_exists(file.c_str())) {
+		mkdir(getPathName(dir).c_str(), 0755);
+		mkdir(dir.c_str(), 0755);
+		prune();
+	}
+	bool ok = writeFile(file, body);
+	if (ok && (enc != CEncoder::encIdentity) && !encoded.empty())
+		ok = writeFile(keyFile(key, enc), encoded);
+	return ok;
+}
+
+/* encoded copies of a response */
+void CResponseCache::removeEncoded(const string& file)
+{
+	static const int encs[] = { CEncoder::encDeflate, CEncoder::encGzip, CEncoder::encZstd };
+	for (size_t i = 0; i < sizeof(encs) / sizeof(encs[0]); i++)
+		unlink((file + "." + CEncoder::encodingName(encs[i])).c_str());
+}
+
+/* least recently stored first, temporary files of crashed writers age out */
+void CResponseCache::prune()
+{
+	DIR* d = opendir(dir.c_str());
+	if (d == NULL)
+		return;
+
+	time_t now = time(NULL);
+	vector<pair<time_t, string> > files;
+	struct dirent* de;
+	while ((de = readdir(d)) != NULL) {
+		if (de->d_name[0] == '.')
+			continue;
+		string file = dir + "/" + de->d_name;
+		struct stat st;
+		if (stat(file.c_str(), &st) != 0)
+			continue;
+		if (now - st.st_mtime > maxAge)
+			unlink(file.c_str());
+		else if ((file.length() > 5) && (file.compare(file.length() - 5, 5, ".json") == 0))
+			files.push_back(make_pair(st.st_mtime, file));
+	}
+	closedir(d);
+
+	/* room for the file about to be added */
+	if (files.size() < maxFiles)
+		return;
+	sort(files.begin(), files.end());
+	for (size_t i = 0; i <= files.size() - maxFiles; i++) {
+		unlink(files[i].second.c_str());
+		removeEncoded(files[i].second);
+	}
+}
+
+bool CResponseCache::readFile(const string& file, string* data, time_t* mtime)
+{
+	struct stat st;
+	if ((stat(file.c_str(), &st) != 0) || (time(NULL) - st.st_mtime > maxAge))
+		return false;
+
+	*data = ::readFile(file);
+	*mtime = st.st_mtime;
+	return !data->empty();
+}
+
+/*
+ * encoded: body is in content encoding enc, for COutput::writeEncoded().
+ * An encoded copy that fell behind the plain body (only other clients
+ * refreshed it) is not used.
+ */
+bool CResponseCache::load(const string& key, int enc, string* body, bool* encoded, int* age)
+{
+	if (maxAge <= 0)
+		return false;
+
+	string file = keyFile(key, CEncoder::encIdentity);
+	time_t mtime;
+	if (!readFile(file, body, &mtime))
+		return false;
+
+	*encoded = false;
+	string encBody;
+	time_t encTime;
+	if ((enc != CEncoder::encIdentity) && readFile(keyFile(key, enc), &encBody, &encTime) &&
+	    (encTime + refreshInterval >= mtime)) {
+		body->swap(encBody);
+		*encoded = true;
+	}
+	time_t diff = time(NULL) - mtime;
+	*age = (diff > 0) ? static_cast<int>(diff) : 0;
+	return true;
+}
@@ -0,0 +1,57 @@
+
+#ifndef __RESPCACHE_H__
+#define __RESPCACHE_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <string>
+
+using namespace std;
+
+/*
+ * Last good response per query, one file per key in <cache>/responses.
+ * The key is the parsed query (CMtApi::queryKey()), not the raw request.
+ * A request whose database work failed or ran past its deadline is
+ * answered from here instead of waiting. Files are written next to a
+ * temporary name and renamed, at most once per refreshInterval per key.
+ * Adding a key prunes the directory to the maxFiles most recently
+ * stored responses and drops those past maxAge. Next to the plain body
+ * (<hash>.json) each content encoding a client asked for is kept as it
+ * went out (<hash>.json.gzip etc.), so a hit is sent without compressing
+ * it again.
+ *
+ * MT_API_STALE_MAX_AGE		oldest response still served in s (default 86400, 0: off)
+ * MT_API_STALE_MAX_FILES	responses kept (default 2000)
+ */
+class CResponseCache
+{
+	private:
+		enum {
+			refreshInterval = 10	/* s */
+		};
+
+		string dir;
+		int maxAge;
+		size_t maxFiles;
+
+		string keyFile(const string& key, int enc);
+		bool writeFile(const string& file, const string& data);
+		bool readFile(const string& file, string* data, time_t* mtime);
+		void removeEncoded(const string& file);
+		void prune();
+
+	public:
+		CResponseCache(string cacheDir);
+		~CResponseCache() {};
+
+		bool store(const string& key, const string& body, int enc, const string& encoded);
+		bool load(const string& key, int enc, string* body, bool* encoded, int* age);
+};
+
+
+#endif // __RESPCACHE_H__
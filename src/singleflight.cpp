@@ -0,0 +1,265 @@
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+
+#include <fstream>
+#include <string>
+
+#include "common/helpers.h"
+#include "compress.h"
+#include "singleflight.h"
+
+static const uint32_t flightMagic	= 0x4d544631; /* "MTF1" */
+static const uint32_t flightVersion	= 2;
+
+CSingleFlight::CSingleFlight(string file, string dir)
+{
+	shmFile		= file;
+	resultDir	= dir;
+	fd		= -1;
+	data		= NULL;
+	key		= 0;
+	slot		= -1;
+	leader		= false;
+	seq		= 0;
+
+	const char* coalesceEnv = getenv("MT_API_COALESCE");
+	if (!coalesceEnv || (atoi(coalesceEnv) != 0))
+		attach();
+}
+
+CSingleFlight::~CSingleFlight()
+{
+	/* followers must not wait for a leader that gave up */
+	if (leader)
+		finish(false, "");
+	if (data != NULL)
+		munmap(data, sizeof(flightData_t));
+	if (fd >= 0)
+		close(fd);
+}
+
+/* without the mapping every request is its own leader */
+bool CSingleFlight::attach()
+{
+	bool fresh;
+	void* p = mapSharedFile(shmFile, sizeof(flightData_t), flightMagic, flightVersion, &fd, &fresh);
+	if (p == NULL) {
+		fd = -1;
+		return false;
+	}
+	data = static_cast<flightData_t*>(p);
+	if (fresh) {
+		memset(data, 0, sizeof(flightData_t));
+		data->version	= flightVersion;
+		data->magic	= flightMagic;
+	}
+	unlock();
+
+	return (data != NULL);
+}
+
+bool CSingleFlight::lock()
+{
+	int ret;
+	while (((ret = flock(fd, LOCK_EX)) != 0) && (errno == EINTR))
+		;
+	return (ret == 0);
+}
+
+void CSingleFlight::unlock()
+{
+	flock(fd, LOCK_UN);
+}
+
+bool CSingleFlight::alive(pid_t pid)
+{
+	return ((kill(pid, 0) == 0) || (errno != ESRCH));
+}
+
+/* FNV-1a, never 0 */
+uint64_t CSingleFlight::hashKey(const string& data)
+{
+	uint64_t h = 14695981039346656037ULL;
+	for (size_t i = 0; i < data.length(); i++) {
+		h ^= static_cast<unsigned char>(data[i]);
+		h *= 1099511628211ULL;
+	}
+	return (h != 0) ? h : 1;
+}
+
+string CSingleFlight::resultFile(uint64_t k, uint64_t resultSeq)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "%016llx-%llu.json", static_cast<unsigned long long>(k),
+		 static_cast<unsigned long long>(resultSeq));
+	return resultDir + "/" + name;
+}
+
+bool CSingleFlight::writeFile(const string& file, const string& content)
+{
+	string tmpFile = file + "." + to_string(getpid()) + ".tmp";
+	ofstream out(tmpFile.c_str(), ios::trunc | ios::binary);
+	out << content;
+	out.close();
+	if (!out.good() || (rename(tmpFile.c_str(), file.c_str()) != 0)) {
+		unlink(tmpFile.c_str());
+		return false;
+	}
+	return true;
+}
+
+/* the encoded copy first: a follower that sees the plain file finds both */
+bool CSingleFlight::writeResult(uint64_t resultSeq, const string& body, int enc, const string& encoded)
+{
+	mkdir(resultDir.c_str(), 0755);
+	string file = resultFile(key, resultSeq);
+	if ((enc != CEncoder::encIdentity) && !encoded.empty())
+		writeFile(file + "." + CEncoder::encodingName(enc), encoded);
+	return writeFile(file, body);
+}
+
+void CSingleFlight::removeResult(uint64_t k, uint64_t resultSeq)
+{
+	static const int encs[] = { CEncoder::encDeflate, CEncoder::encGzip, CEncoder::encZstd };
+	string file = resultFile(k, resultSeq);
+	unlink(file.c_str());
+	for (size_t i = 0; i < sizeof(encs) / sizeof(encs[0]); i++)
+		unlink((file + "." + CEncoder::encodingName(encs[i])).c_str());
+}
+
+/*
+ * true: the caller is the leader (or coalescing is off) and runs the
+ * query, then hands the result to finish(). false: the query is already
+ * running in another process, wait() for its result.
+ */
+bool CSingleFlight::join(uint64_t k)
+{
+	key = k;
+	if ((data == NULL) || !lock()) {
+		leader = false;
+		return true;
+	}
+
+	slot_t* own = NULL;
+	slot_t* spare = NULL;
+	for (size_t i = 0; i < slotProbe; i++) {
+		slot_t* e = &data->slots[(key + i) & (slotCount - 1)];
+		bool running = ((e->state == stateRunning) && alive(e->pid));
+		if (e->key == key) {
+			if (running) {
+				e->waiters++;
+				slot = static_cast<int>(e - data->slots);
+				seq  = e->seq;
+				unlock();
+				return false;
+			}
+			own = e;
+			break;
+		}
+		if ((spare == NULL) && !running)
+			spare = e;
+	}
+	if (own == NULL)
+		own = spare;
+	/* all probed slots busy with other queries: run without coalescing */
+	if (own != NULL) {
+		/* followers of the last flight still reading fall back to their own query */
+		if ((own->key != 0) && (own->result == stateDone))
+			removeResult(own->key, own->seq);
+		own->key	= key;
+		own->pid	= getpid();
+		own->state	= stateRunning;
+		own->result	= stateFailed;
+		own->waiters	= 0;
+		slot		= static_cast<int>(own - data->slots);
+		leader		= true;
+	}
+	unlock();
+
+	return true;
+}
+
+/*
+ * false: no result from the leader, the caller runs the query itself.
+ * encoded: body is in content encoding enc, for COutput::writeEncoded().
+ */
+bool CSingleFlight::wait(int64_t timeoutMs, int enc, string* body, bool* encoded)
+{
+	if ((data == NULL) || (slot < 0) || leader)
+		return false;
+
+	slot_t* e = &data->slots[slot];
+	uint64_t resultSeq = 0;
+	struct timespec pause = { 0, pollInterval * 1000000L };
+	for (int64_t waited = 0; waited < timeoutMs; waited += pollInterval) {
+		if (__atomic_load_n(&e->seq, __ATOMIC_ACQUIRE) != seq) {
+			if (lock()) {
+				/* the slot may already carry the next flight of the key */
+				if ((e->key == key) && (e->result == stateDone))
+					resultSeq = e->seq;
+				unlock();
+			}
+			break;
+		}
+		if (!alive(__atomic_load_n(&e->pid, __ATOMIC_RELAXED)))
+			break;
+		nanosleep(&pause, NULL);
+	}
+
+	*encoded = false;
+	if (resultSeq != 0) {
+		string file = resultFile(key, resultSeq);
+		if (enc != CEncoder::encIdentity) {
+			*body = readFile(file + "." + CEncoder::encodingName(enc));
+			*encoded = !body->empty();
+		}
+		if (!*encoded)
+			*body = readFile(file);
+	}
+
+	bool last = false;
+	if (lock()) {
+		if ((e->key == key) && (e->waiters > 0))
+			last = (--e->waiters == 0);
+		unlock();
+	}
+	if (last && (resultSeq != 0))
+		removeResult(key, resultSeq);
+
+	return ((resultSeq != 0) && !body->empty());
+}
+
+/* publishes the result of a leader and wakes the followers */
+void CSingleFlight::finish(bool ok, const string& body, int enc, const string& encoded)
+{
+	if (!leader)
+		return;
+	leader = false;
+
+	if (!lock())
+		return;
+	slot_t* e = &data->slots[slot];
+	bool write = (ok && (e->key == key) && (e->pid == getpid()) && (e->waiters > 0));
+	uint64_t resultSeq = e->seq + 1;
+	unlock();
+
+	/* nobody waits: no disk write on the hot path */
+	if (write)
+		write = writeResult(resultSeq, body, enc, encoded);
+
+	if (!lock())
+		return;
+	if ((e->key == key) && (e->pid == getpid())) {
+		e->state  = (ok) ? stateDone : stateFailed;
+		e->result = (write) ? stateDone : stateFailed;
+		__atomic_store_n(&e->seq, resultSeq, __ATOMIC_RELEASE);
+	}
+	unlock();
+}
@@ -0,0 +1,97 @@
+
+#ifndef __SINGLEFLIGHT_H__
+#define __SINGLEFLIGHT_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include <string>
+
+#include "compress.h"
+
+using namespace std;
+
+/*
+ * Coalescing of identical queries running at the same time in different
+ * CGI processes, through a file mapping (<cache>/flight.shm). The first
+ * process to join() a key becomes the leader and runs the query, later
+ * ones register in the slot and wait for its result. Only when followers
+ * are registered, the leader writes the serialized response to
+ * <cache>/flight/<key>-<seq>.json, plus the copy in its own content
+ * encoding (<key>-<seq>.json.gzip etc.) that followers asking for the
+ * same encoding send as is; it then bumps the sequence number of the
+ * slot. The last follower to leave removes the file, a leftover one
+ * goes when the slot gets its next leader. A follower whose leader
+ * fails, dies or outlasts the wait runs the query itself. The table is
+ * changed under flock() like CLimiter.
+ *
+ * MT_API_COALESCE	0: every request runs its own query (default 1)
+ */
+class CSingleFlight
+{
+	public:
+		enum {
+			slotCount	= 256,	/* power of 2 */
+			slotProbe	= 8,
+			pollInterval	= 2	/* ms */
+		};
+
+		enum {
+			stateFree,
+			stateRunning,
+			stateDone,
+			stateFailed
+		};
+
+	private:
+		struct slot_t {
+			uint64_t key;		/* 0: free */
+			pid_t pid;		/* leader */
+			uint32_t state;
+			uint32_t result;	/* stateDone: the last finish() wrote a result file */
+			uint64_t seq;		/* bumped by every finish() */
+			uint32_t waiters;	/* followers in wait() */
+			uint32_t reserved;
+		};
+
+		/* layout of the shared mapping, bump flightVersion on changes */
+		struct flightData_t {
+			uint32_t magic;
+			uint32_t version;
+			slot_t slots[slotCount];
+		};
+
+		string shmFile;
+		string resultDir;
+		int fd;
+		flightData_t* data;
+		uint64_t key;
+		int slot;
+		bool leader;
+		uint64_t seq;
+
+		bool attach();
+		bool lock();
+		void unlock();
+		string resultFile(uint64_t k, uint64_t resultSeq);
+		bool writeFile(const string& file, const string& content);
+		bool writeResult(uint64_t resultSeq, const string& body, int enc, const string& encoded);
+		void removeResult(uint64_t k, uint64_t resultSeq);
+		static bool alive(pid_t pid);
+
+	public:
+		CSingleFlight(string file, string dir);
+		~CSingleFlight();
+
+		static uint64_t hashKey(const string& data);
+		bool join(uint64_t k);
+		bool wait(int64_t timeoutMs, int enc, string* body, bool* encoded);
+		void finish(bool ok, const string& body, int enc=CEncoder::encIdentity, const string& encoded="");
+};
+
+
+#endif // __SINGLEFLIGHT_H__
@@ -5,6 +5,7 @@
 #include <fcntl.h>
 #include <libgen.h>
 #include <errno.h>
+#include <sys/socket.h>
 
 #include <iostream>
 #include <fstream>
@@ -17,6 +18,8 @@
 #include "mt-api.h"
 #include "json.h"
 #include "sql.h"
+#include "timing.h"
+#include "metrics.h"
 
 extern CMtApi*		g_mainInstance;
 extern string		g_dataRoot;
@@ -26,7 +29,7 @@ extern string		g_msgBoxText;
 extern const char*	g_progNameShort;
 extern const char*	g_progVersion;
 
-CSql::CSql()
+CSql::CSql() : CDbBackend()
 {
 	Init();
 }
@@ -35,16 +38,21 @@ void CSql::Init()
 {
 	mysqlCon = NULL;
 	pwFile		= g_dataRoot + "/.passwd/sqlpasswd";
-	usedDB		= "mediathek_1";
+	const char* nameEnv = getenv("MT_API_DB_NAME");
+	usedDB		= (nameEnv && *nameEnv) ? nameEnv : "mediathek_1";
 	const char* hostEnv = getenv("MT_API_DB_HOST");
 	if (hostEnv && *hostEnv)
 		mysqlHost = hostEnv;
 	else
 		mysqlHost = "127.0.0.1";
+	const char* portEnv = getenv("MT_API_DB_PORT");
+	mysqlPort	= (portEnv && *portEnv) ? atoi(portEnv) : 3306;
 	tabChannelinfo	= "channelinfo";
 	tabVersion	= "version";
 	tabVideo	= "video";
-	resultCount	= 0;
+	videoColumns	= "";
+	videoColumns	+= " channel, theme, title, description, website, subtitle, url, url_small, url_hd, url_rtmp,";
+	videoColumns	+= " url_rtmp_small, url_rtmp_hd, url_history, date_unix, duration, size_mb, geo, parse_m3u8";
 }
 
 CSql::~CSql()
@@ -53,19 +61,57 @@ CSql::~CSql()
 		mysql_close(mysqlCon);
 }
 
-void CSql::show_error(const char* func, int line)
+void CSql::show_error(const char* func, int line, MYSQL_RES* pending/*=NULL*/)
 {
+	/* the first error closed the connection and has been reported */
+	if (mysqlCon == NULL)
+		return;
+
 	std::ostringstream oss;
 	oss << "<span style='color: OrangeRed'>[" << func << ':' << line
 	    << "] Error(" << mysql_errno(mysqlCon) << ") ["
 	    << mysql_sqlstate(mysqlCon) << "] \"" << mysql_error(mysqlCon)
 	    << "\"\n<br /></span>";
 	g_msgBoxText = oss.str();
+	g_mainInstance->metrics->countDbError();
+
+	if (pending != NULL) {
+		abandonResult(pending);
+		return;
+	}
+	mysql_close(mysqlCon);
+	mysqlCon = NULL;
+}
 
+/*
+ * Frees a mysql_use_result() result with unread rows and closes the
+ * connection. mysql_free_result() reads the remaining rows from the
+ * server; with the socket shut down it returns at once.
+ */
+void CSql::abandonResult(MYSQL_RES* result)
+{
+	shutdown(mysql_get_socket(mysqlCon), SHUT_RDWR);
+	mysql_free_result(result);
 	mysql_close(mysqlCon);
 	mysqlCon = NULL;
 }
 
+/* false also when show_error() closed the connection after an earlier failure */
+bool CSql::query(const string& sql)
+{
+	if (mysqlCon == NULL)
+		return false;
+	return (mysql_real_query(mysqlCon, sql.c_str(), sql.length()) == 0);
+}
+
+/* NULL is an empty result unless mysql_errno() is set */
+MYSQL_RES* CSql::storeResult()
+{
+	if (mysqlCon == NULL)
+		return NULL;
+	return mysql_store_result(mysqlCon);
+}
+
 bool CSql::connectMysql()
 {
 	string pw = readFile(pwFile);
@@ -73,11 +119,21 @@ bool CSql::connectMysql()
 	vector<string> v = split(pw, ':');
 
 	mysqlCon = mysql_init(NULL);
+	/* connect, read and write wait no longer than the request may take */
+	int64_t left = timeLeftMs();
+	if (left != INT64_MAX) {
+		unsigned int timeout = static_cast<unsigned int>((left + 999) / 1000);
+		if (timeout < 1)
+			timeout = 1;
+		mysql_options(mysqlCon, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
+		mysql_options(mysqlCon, MYSQL_OPT_READ_TIMEOUT, &timeout);
+		mysql_options(mysqlCon, MYSQL_OPT_WRITE_TIMEOUT, &timeout);
+	}
 	unsigned long flags = 0;
 //	flags |= CLIENT_MULTI_STATEMENTS;
 //	flags |= CLIENT_COMPRESS;
 	const char* host = mysqlHost.c_str();
-	if (!mysql_real_connect(mysqlCon, host, v[0].c_str(), v[1].c_str(), usedDB.c_str(), 3306, NULL, flags)) {
+	if (!mysql_real_connect(mysqlCon, host, v[0].c_str(), v[1].c_str(), usedDB.c_str(), mysqlPort, NULL, flags)) {
 		show_error(__func__, __LINE__);
 		return false;
 	}
@@ -90,33 +146,35 @@ bool CSql::connectMysql()
 	return true;
 }
 
-string CSql::formatSql(string data, int id, string tagBefore, string tagAfter)
+bool CSql::connect()
 {
-	string html = readFile(g_dataRoot + "/template/sql-format.html");
-	data = base64encode(data);
-	html = str_replace("@@@SQL_DATA@@@", data, html);
-	html = str_replace("@@@ID@@@", to_string(id), html);
-
-	return tagBefore + html + tagAfter;
+	return connectMysql();
 }
 
-double CSql::startTimer()
+/* EXPLAIN of a statement as text, one line per plan row */
+string CSql::explainQuery(string sql)
 {
-	struct timeval t1;
-	gettimeofday(&t1, NULL);
-	return (double)t1.tv_sec*1000ULL + ((double)t1.tv_usec)/1000ULL;
-}
+	string explain = "EXPLAIN " + sql;
+	if (!query(explain))
+		return string("EXPLAIN failed: ") + ((mysqlCon != NULL) ? mysql_error(mysqlCon) : "no connection");
 
-string CSql::getTimer(double startTime, string txt, int preci/*=3*/)
-{
-	struct timeval t1;
-	gettimeofday(&t1, NULL);
-	double workDTms = (double)t1.tv_sec*1000ULL + ((double)t1.tv_usec)/1000ULL;
-	std::ostringstream oss;
-	oss.setf(std::ios::fixed);
-	oss << txt << ' ' << std::setprecision(preci)
-	    << ((workDTms - startTime) / 1000ULL) << " sec";
-	return oss.str();
+	string ret = "";
+	MYSQL_RES* result = storeResult();
+	if (result) {
+		unsigned int fieldCount = mysql_num_fields(result);
+		MYSQL_FIELD* fields = mysql_fetch_fields(result);
+		MYSQL_ROW row;
+		while ((row = mysql_fetch_row(result))) {
+			for (unsigned int i = 0; i < fieldCount; i++) {
+				if (i > 0)
+					ret += " ";
+				ret += string(fields[i].name) + "=" + ((row[i] != NULL) ? row[i] : "NULL");
+			}
+			ret += "\n";
+		}
+		mysql_free_result(result);
+	}
+	return ret;
 }
 
 int CSql::row2int(MYSQL_ROW& row, uint64_t* lengths, int index)
@@ -137,89 +195,111 @@ string CSql::row2string(MYSQL_ROW& row, uint64_t* lengths, int index)
 	return tmp_s.substr(0, lengths[index]);
 }
 
-int CSql::getResultCount(string where)
+void CSql::row2listVideo(MYSQL_ROW& row, uint64_t* lengths, listVideo_t* lv)
+{
+	g_mainInstance->cjson->resetListVideoStruct(lv);
+	if ((row == NULL) || (row[0] == NULL))
+		return;
+
+	int index = 0;
+	lv->channel		= row2string(row, lengths, index++);
+	lv->theme		= row2string(row, lengths, index++);
+	lv->title		= row2string(row, lengths, index++);
+	lv->description		= row2string(row, lengths, index++);
+	lv->website		= row2string(row, lengths, index++);
+	lv->subtitle		= row2string(row, lengths, index++);
+	lv->url			= row2string(row, lengths, index++);
+	lv->url_small		= row2string(row, lengths, index++);
+	lv->url_hd		= row2string(row, lengths, index++);
+	lv->url_rtmp		= row2string(row, lengths, index++);
+	lv->url_rtmp_small	= row2string(row, lengths, index++);
+	lv->url_rtmp_hd		= row2string(row, lengths, index++);
+	lv->url_history		= row2string(row, lengths, index++);
+	lv->date_unix		= row2int(row, lengths, index++);
+	lv->duration		= row2int(row, lengths, index++);
+	lv->size_mb		= row2int(row, lengths, index++);
+	lv->geo			= row2string(row, lengths, index++);
+	lv->parse_m3u8		= row2int(row, lengths, index++);
+}
+
+string CSql::resultCountSql(string where)
+{
+	return "SELECT COUNT(id) AS anz FROM " + tabVideo + " " + where + ";";
+}
+
+int CSql::fetchResultCount(MYSQL_RES* result)
+{
+	int ret = 0;
+	if (mysql_num_fields(result) > 0) {
+		MYSQL_ROW row;
+		row = mysql_fetch_row(result);
+		uint64_t* lengths = mysql_fetch_lengths(result);
+		if ((row != NULL) && (row[0] != NULL)) {
+			ret = row2int(row, lengths, 0);
+		}
+	}
+	return ret;
+}
+
+int CSql::getResultCount(string where, cmdListVideo_t* clv/*=NULL*/)
 {
 	if (mysqlCon == NULL)
 		return 0;
 
-	string sql = "";
-        sql += "SELECT COUNT(id) AS anz FROM " + tabVideo + " " + where + ";";
+	string sql = resultCountSql(where);
 
-//	double timer = startTimer();
+	CStageTimer* timer = g_mainInstance->timer;
+	timer->begin(CStageTimer::stageCountQuery);
+	int64_t queryStart = CStageTimer::now();
 
-	if (mysql_real_query(mysqlCon, sql.c_str(), sql.length()) != 0) {
+	if (!query(sql)) {
+		timer->end(CStageTimer::stageCountQuery);
 		show_error(__func__, __LINE__);
-		return false;
+		return 0;
 	}
 
 	int ret = 0;
-	MYSQL_RES* result = mysql_store_result(mysqlCon);
+	MYSQL_RES* result = storeResult();
 	if (result) {
-		if (mysql_num_fields(result) > 0) {
-			MYSQL_ROW row;
-			row = mysql_fetch_row(result);
-			uint64_t* lengths = mysql_fetch_lengths(result);
-			if ((row != NULL) && (row[0] != NULL)) {
-				ret = row2int(row, lengths, 0);
-			}
-		}
+		ret = fetchResultCount(result);
 		mysql_free_result(result);
 	}
+	else if (mysql_errno(mysqlCon) != 0) {
+		timer->end(CStageTimer::stageCountQuery);
+		show_error(__func__, __LINE__);
+		return 0;
+	}
 
-//	string timer_s = getTimer(timer, "Duration sql query 1: ");
+	timer->end(CStageTimer::stageCountQuery);
 
 	if (g_debugMode)
 		g_mainInstance->htmlOut << formatSql(sql, 1, "", "") << endl;
+	checkQuery(sql, 1, CStageTimer::now() - queryStart, ret, clv);
 
 	return ret;
 }
 
-bool CSql::sqlListVideo(cmdListVideo_t* clv, listVideoHead_t* lvh, vector<listVideo_t>& lv)
+string CSql::listVideoWhere(cmdListVideo_t* clv, listVideoHead_t* lvh)
 {
-	if (mysqlCon == NULL)
-		return false;
-
-	time_t now      = (clv->refTime == 0) ? time(0) : clv->refTime;
-	time_t fromTime = 0;
-	time_t toTime   = 0;
-
-	g_mainInstance->cjson->resetListVideoHeadStruct(lvh);
-	lvh->refTime	= now;
-
-	time_t epoch = clv->epoch;
-	/* (clv->epoch < 0) => all data */
-	if (epoch == 0)
-		epoch = 1;
-
-	if (epoch > 0) {
-		epoch = epoch * 3600 * 24;
-		fromTime = now;
-		toTime   = now - epoch;
-		if (clv->timeMode == timeMode_future)
-			fromTime += epoch;
-	}
+	time_t fromTime, toTime;
+	int range = listVideoRange(clv, lvh, &fromTime, &toTime);
 
 	string where = "";
 	where += " WHERE ( channel LIKE " + checkString(clv->channel, 128);
 	where += " AND duration >= " + checkInt(clv->duration);
-	if (epoch > 0) {
+	if (range != rangeNone)
 		where += " AND date_unix < " + checkInt(fromTime);
+	if (range == rangeBetween)
 		where += " AND date_unix > " + checkInt(toTime);
-	}
-	else {
-		if (clv->timeMode != timeMode_future)
-			where += " AND date_unix < " + checkInt(now);
-	}
 	where += " )";
 
-	resultCount = getResultCount(where);
-
-//	double timer = startTimer();
+	return where;
+}
 
+string CSql::listVideoSql(cmdListVideo_t* clv, string where)
+{
 	string sql0 = "";
-	sql0 += "SELECT";
-	sql0 += " channel, theme, title, description, website, subtitle, url, url_small, url_hd, url_rtmp,";
-	sql0 += " url_rtmp_small, url_rtmp_hd, url_history, date_unix, duration, size_mb, geo, parse_m3u8";
+	sql0 += "SELECT" + videoColumns;
 	sql0 += " FROM " + tabVideo;
 	sql0 += where;
 	sql0 += " ORDER BY date_unix DESC";
@@ -232,92 +312,206 @@ bool CSql::sqlListVideo(cmdListVideo_t* clv, listVideoHead_t* lvh, vector<listVi
 	sql += " ) AS dingens";
 	sql += " ORDER BY date_unix DESC, title ASC;";
 
-	if (mysql_real_query(mysqlCon, sql.c_str(), sql.length()) != 0) {
+	return sql;
+}
+
+void CSql::fetchListVideo(MYSQL_RES* result, vector<listVideo_t>& lv)
+{
+	if (mysql_num_fields(result) > 0) {
+		MYSQL_ROW row;
+		while ((row = mysql_fetch_row(result))) {
+			listVideo_t lvv;
+			uint64_t* lengths = mysql_fetch_lengths(result);
+			row2listVideo(row, lengths, &lvv);
+			lv.push_back(lvv);
+			rowCount++;
+		}
+	}
+}
+
+bool CSql::sqlListVideo(cmdListVideo_t* clv, listVideoHead_t* lvh, vector<listVideo_t>& lv)
+{
+	if (!ready())
+		return false;
+
+	string where = listVideoWhere(clv, lvh);
+
+	resultCount = getResultCount(where, clv);
+
+	string sql = listVideoSql(clv, where);
+
+	CStageTimer* timer = g_mainInstance->timer;
+	timer->begin(CStageTimer::stagePageQuery);
+	int64_t queryStart = CStageTimer::now();
+	size_t rowsBefore = lv.size();
+	if (!query(sql)) {
+		timer->end(CStageTimer::stagePageQuery);
 		show_error(__func__, __LINE__);
 		return false;
 	}
 
-	MYSQL_RES* result = mysql_store_result(mysqlCon);
+	MYSQL_RES* result = storeResult();
+	timer->end(CStageTimer::stagePageQuery);
+	if ((result == NULL) && (mysql_errno(mysqlCon) != 0)) {
+		show_error(__func__, __LINE__);
+		return false;
+	}
 	if (result) {
-		if (mysql_num_fields(result) > 0) {
-			MYSQL_ROW row;
-			while ((row = mysql_fetch_row(result))) {
-				listVideo_t lvv;
-				g_mainInstance->cjson->resetListVideoStruct(&lvv);
-				uint64_t* lengths = mysql_fetch_lengths(result);
-				if ((row != NULL) && (row[0] != NULL)) {
-					int index = 0;
-					lvv.channel		= row2string(row, lengths, index++);
-					lvv.theme		= row2string(row, lengths, index++);
-					lvv.title		= row2string(row, lengths, index++);
-					lvv.description		= row2string(row, lengths, index++);
-					lvv.website		= row2string(row, lengths, index++);
-					lvv.subtitle		= row2string(row, lengths, index++);
-					lvv.url			= row2string(row, lengths, index++);
-					lvv.url_small		= row2string(row, lengths, index++);
-					lvv.url_hd		= row2string(row, lengths, index++);
-					lvv.url_rtmp		= row2string(row, lengths, index++);
-					lvv.url_rtmp_small	= row2string(row, lengths, index++);
-					lvv.url_rtmp_hd		= row2string(row, lengths, index++);
-					lvv.url_history		= row2string(row, lengths, index++);
-					lvv.date_unix		= row2int(row, lengths, index++);
-					lvv.duration		= row2int(row, lengths, index++);
-					lvv.size_mb		= row2int(row, lengths, index++);
-					lvv.geo			= row2string(row, lengths, index++);
-					lvv.parse_m3u8		= row2int(row, lengths, index++);
-				}
-				lv.push_back(lvv);
-			}
-		}
+		timer->begin(CStageTimer::stageRowMapping);
+		fetchListVideo(result, lv);
+		timer->end(CStageTimer::stageRowMapping);
 		mysql_free_result(result);
 	}
 
-	int rowsCount = static_cast<int>(lv.size());
-	lvh->start	= clv->start;
-	lvh->end	= clv->start + rowsCount - 1;
-	lvh->rows	= rowsCount;
-	lvh->total	= resultCount;
-
-//	string timer_s = getTimer(timer, "Duration sql query 2: ");
+	setListVideoHead(clv, lvh, static_cast<int>(lv.size()), resultCount);
 
 	if (g_debugMode)
 		g_mainInstance->htmlOut << formatSql(sql, 2, "", "") << endl;
+	checkQuery(sql, 2, CStageTimer::now() - queryStart, lv.size() - rowsBefore, clv);
 
 	return true;
 }
 
-bool CSql::sqlGetProgInfo(progInfo_t* pi)
+/* Run sql and hand the rows one by one to callback, without storing the result */
+bool CSql::streamVideoRows(string sql, exportVideoCallback_t callback, int* rows)
 {
-	if (mysqlCon == NULL)
+	CStageTimer* timer = g_mainInstance->timer;
+	timer->begin(CStageTimer::stagePageQuery);
+	if (!query(sql)) {
+		timer->end(CStageTimer::stagePageQuery);
+		show_error(__func__, __LINE__);
+		return false;
+	}
+
+	MYSQL_RES* result = mysql_use_result(mysqlCon);
+	timer->end(CStageTimer::stagePageQuery);
+	if (result == NULL) {
+		show_error(__func__, __LINE__);
+		return false;
+	}
+
+	bool ret = true;
+	int count = 0;
+	if (mysql_num_fields(result) > 0) {
+		MYSQL_ROW row;
+		while ((row = mysql_fetch_row(result))) {
+			listVideo_t lvv;
+			timer->begin(CStageTimer::stageRowMapping);
+			uint64_t* lengths = mysql_fetch_lengths(result);
+			row2listVideo(row, lengths, &lvv);
+			timer->end(CStageTimer::stageRowMapping);
+			count++;
+			rowCount++;
+			if (!callback(&lvv)) {
+				ret = false;
+				break;
+			}
+		}
+	}
+	/* callback gave up: drop the rest of the rows instead of reading them */
+	if (!ret) {
+		abandonResult(result);
+		return false;
+	}
+	if (mysql_errno(mysqlCon) != 0) {
+		show_error(__func__, __LINE__, result);
+		return false;
+	}
+	mysql_free_result(result);
+	if (rows != NULL)
+		*rows = count;
+
+	return ret;
+}
+
+bool CSql::sqlExportVideos(exportVideoCallback_t callback)
+{
+	if (!ready())
+		return false;
+
+	string sql = "";
+	sql += "SELECT" + videoColumns;
+	sql += " FROM " + tabVideo;
+	sql += " ORDER BY channel ASC, date_unix DESC, title ASC;";
+
+	/* stream the rows, the whole table does not fit into memory */
+	return streamVideoRows(sql, callback, NULL);
+}
+
+/* Like sqlListVideo, but the rows go to callback as they arrive */
+bool CSql::sqlStreamVideo(cmdListVideo_t* clv, listVideoHead_t* lvh, exportVideoCallback_t callback)
+{
+	if (!ready())
 		return false;
 
+	string where = listVideoWhere(clv, lvh);
+	resultCount = getResultCount(where, clv);
+
+	string sql = listVideoSql(clv, where);
+	int rows = 0;
+	int64_t queryStart = CStageTimer::now();
+	bool ret = streamVideoRows(sql, callback, &rows);
+	setListVideoHead(clv, lvh, rows, resultCount);
+	if (ret)
+		checkQuery(sql, 2, CStageTimer::now() - queryStart, rows, clv);
+
+	return ret;
+}
+
+string CSql::progInfoSql()
+{
 	string sql = "";
 	sql += "SELECT version, vdate, mvversion, mvdate, mventrys, progname, progversion";
 	sql += " FROM " + tabVersion;
 	sql += " LIMIT 1;";
+	return sql;
+}
+
+void CSql::fetchProgInfo(MYSQL_RES* result, progInfo_t* pi)
+{
+	if (mysql_num_fields(result) > 0) {
+		MYSQL_ROW row;
+		row = mysql_fetch_row(result);
+		uint64_t* lengths = mysql_fetch_lengths(result);
+		if ((row != NULL) && (row[0] != NULL)) {
+			int index = 0;
+			pi->version	= row2string(row, lengths, index++);
+			pi->vdate	= row2int(row, lengths, index++);
+			pi->mvversion	= row2string(row, lengths, index++);
+			pi->mvdate	= row2int(row, lengths, index++);
+			pi->mventrys	= row2int(row, lengths, index++);
+			pi->progname	= row2string(row, lengths, index++);
+			pi->progversion	= row2string(row, lengths, index++);
+			rowCount++;
+		}
+	}
+}
+
+bool CSql::sqlGetProgInfo(progInfo_t* pi)
+{
+	if (!ready())
+		return false;
+
+	string sql = progInfoSql();
 
-	if (mysql_real_query(mysqlCon, sql.c_str(), sql.length()) != 0) {
+	CStageTimer* timer = g_mainInstance->timer;
+	timer->begin(CStageTimer::stageQuery);
+	if (!query(sql)) {
+		timer->end(CStageTimer::stageQuery);
 		show_error(__func__, __LINE__);
 		return false;
 	}
 
-	MYSQL_RES* result = mysql_store_result(mysqlCon);
+	MYSQL_RES* result = storeResult();
+	timer->end(CStageTimer::stageQuery);
+	if ((result == NULL) && (mysql_errno(mysqlCon) != 0)) {
+		show_error(__func__, __LINE__);
+		return false;
+	}
 	if (result) {
-		if (mysql_num_fields(result) > 0) {
-			MYSQL_ROW row;
-			row = mysql_fetch_row(result);
-			uint64_t* lengths = mysql_fetch_lengths(result);
-			if ((row != NULL) && (row[0] != NULL)) {
-				int index = 0;
-				pi->version	= row2string(row, lengths, index++);
-				pi->vdate	= row2int(row, lengths, index++);
-				pi->mvversion	= row2string(row, lengths, index++);
-				pi->mvdate	= row2int(row, lengths, index++);
-				pi->mventrys	= row2int(row, lengths, index++);
-				pi->progname	= row2string(row, lengths, index++);
-				pi->progversion	= row2string(row, lengths, index++);
-			}
-		}
+		timer->begin(CStageTimer::stageRowMapping);
+		fetchProgInfo(result, pi);
+		timer->end(CStageTimer::stageRowMapping);
 		mysql_free_result(result);
 	}
 
@@ -329,40 +523,62 @@ bool CSql::sqlGetProgInfo(progInfo_t* pi)
 	return true;
 }
 
-bool CSql::sqlListLiveStreams(vector<livestreams_t>& ls)
+string CSql::liveStreamsSql()
 {
-	if (mysqlCon == NULL)
-		return false;
-
 	string sql = "";
 	sql += "SELECT title, url, parse_m3u8";
 	sql += " FROM " + tabVideo;
 	sql += " WHERE (theme LIKE 'Livestream' AND title LIKE '%Livestream%')";
 	sql += " ORDER BY channel, title ASC";
 	sql += " LIMIT 50;";
+	return sql;
+}
+
+void CSql::fetchLiveStreams(MYSQL_RES* result, vector<livestreams_t>& ls)
+{
+	if (mysql_num_fields(result) > 0) {
+		MYSQL_ROW row;
+		while ((row = mysql_fetch_row(result))) {
+			livestreams_t lss;
+			g_mainInstance->cjson->resetLiveStreamStruct(&lss);
+			uint64_t* lengths = mysql_fetch_lengths(result);
+			if ((row != NULL) && (row[0] != NULL)) {
+				int index = 0;
+				lss.title	= row2string(row, lengths, index++);
+				lss.url		= row2string(row, lengths, index++);
+				lss.parse_m3u8	= row2int(row, lengths, index++);
+			}
+			ls.push_back(lss);
+			rowCount++;
+		}
+	}
+}
+
+bool CSql::sqlListLiveStreams(vector<livestreams_t>& ls)
+{
+	if (!ready())
+		return false;
 
-	if (mysql_real_query(mysqlCon, sql.c_str(), sql.length()) != 0) {
+	string sql = liveStreamsSql();
+
+	CStageTimer* timer = g_mainInstance->timer;
+	timer->begin(CStageTimer::stageQuery);
+	if (!query(sql)) {
+		timer->end(CStageTimer::stageQuery);
 		show_error(__func__, __LINE__);
 		return false;
 	}
 
-	MYSQL_RES* result = mysql_store_result(mysqlCon);
+	MYSQL_RES* result = storeResult();
+	timer->end(CStageTimer::stageQuery);
+	if ((result == NULL) && (mysql_errno(mysqlCon) != 0)) {
+		show_error(__func__, __LINE__);
+		return false;
+	}
 	if (result) {
-		if (mysql_num_fields(result) > 0) {
-			MYSQL_ROW row;
-			while ((row = mysql_fetch_row(result))) {
-				livestreams_t lss;
-				g_mainInstance->cjson->resetLiveStreamStruct(&lss);
-				uint64_t* lengths = mysql_fetch_lengths(result);
-				if ((row != NULL) && (row[0] != NULL)) {
-					int index = 0;
-					lss.title	= row2string(row, lengths, index++);
-					lss.url		= row2string(row, lengths, index++);
-					lss.parse_m3u8	= row2int(row, lengths, index++);
-				}
-				ls.push_back(lss);
-			}
-		}
+		timer->begin(CStageTimer::stageRowMapping);
+		fetchLiveStreams(result, ls);
+		timer->end(CStageTimer::stageRowMapping);
 		mysql_free_result(result);
 	}
 
@@ -372,45 +588,194 @@ bool CSql::sqlListLiveStreams(vector<livestreams_t>& ls)
 	return true;
 }
 
-bool CSql::sqlListChannels(vector<channels_t>& ch)
+string CSql::channelsSql()
 {
-	if (mysqlCon == NULL)
-		return false;
-
 	string sql = "";
 	sql += "SELECT channel, count, latest, oldest";
 	sql += " FROM " + tabChannelinfo;
 	sql += " ORDER BY channel ASC";
 	sql += " LIMIT 50;";
+	return sql;
+}
+
+void CSql::fetchChannels(MYSQL_RES* result, vector<channels_t>& ch)
+{
+	if (mysql_num_fields(result) > 0) {
+		MYSQL_ROW row;
+		while ((row = mysql_fetch_row(result))) {
+			channels_t chs;
+			g_mainInstance->cjson->resetChannelStruct(&chs);
+			uint64_t* lengths = mysql_fetch_lengths(result);
+			if ((row != NULL) && (row[0] != NULL)) {
+				int index = 0;
+				chs.channel	= row2string(row, lengths, index++);
+				chs.count	= row2int(row, lengths, index++);
+				chs.latest	= row2int(row, lengths, index++);
+				chs.oldest	= row2int(row, lengths, index++);
+			}
+			ch.push_back(chs);
+			rowCount++;
+		}
+	}
+}
 
-	if (mysql_real_query(mysqlCon, sql.c_str(), sql.length()) != 0) {
+bool CSql::sqlListChannels(vector<channels_t>& ch)
+{
+	if (!ready())
+		return false;
+
+	string sql = channelsSql();
+
+	CStageTimer* timer = g_mainInstance->timer;
+	timer->begin(CStageTimer::stageQuery);
+	if (!query(sql)) {
+		timer->end(CStageTimer::stageQuery);
 		show_error(__func__, __LINE__);
 		return false;
 	}
 
-	MYSQL_RES* result = mysql_store_result(mysqlCon);
+	MYSQL_RES* result = storeResult();
+	timer->end(CStageTimer::stageQuery);
+	if ((result == NULL) && (mysql_errno(mysqlCon) != 0)) {
+		show_error(__func__, __LINE__);
+		return false;
+	}
 	if (result) {
-		if (mysql_num_fields(result) > 0) {
-			MYSQL_ROW row;
-			while ((row = mysql_fetch_row(result))) {
-				channels_t chs;
-				g_mainInstance->cjson->resetChannelStruct(&chs);
-				uint64_t* lengths = mysql_fetch_lengths(result);
-				if ((row != NULL) && (row[0] != NULL)) {
-					int index = 0;
-					chs.channel	= row2string(row, lengths, index++);
-					chs.count	= row2int(row, lengths, index++);
-					chs.latest	= row2int(row, lengths, index++);
-					chs.oldest	= row2int(row, lengths, index++);
+		timer->begin(CStageTimer::stageRowMapping);
+		fetchChannels(result, ch);
+		timer->end(CStageTimer::stageRowMapping);
+		mysql_free_result(result);
+	}
+
+	if (g_debugMode)
+		g_mainInstance->htmlOut << formatSql(sql, 1, "", "") << endl;
+
+	return true;
+}
+
+/*
+ * Run the queries of several sub-requests with one round-trip. All
+ * statements are sent as one multi-statement query, the result sets
+ * come back in the same order.
+ */
+/*
+ * Turns multi statements off again when sqlBatch() returns, on every
+ * path. The connection is kept for later queries of the request and
+ * must not run several statements from one string there. Nothing to
+ * do when show_error() already dropped the connection.
+ */
+class CMultiStatementsGuard
+{
+	private:
+		MYSQL*& con;
+
+	public:
+		CMultiStatementsGuard(MYSQL*& con_) : con(con_) {};
+		~CMultiStatementsGuard()
+		{
+			if (con != NULL)
+				mysql_set_server_option(con, MYSQL_OPTION_MULTI_STATEMENTS_OFF);
+		};
+};
+
+bool CSql::sqlBatch(vector<batchRequest_t>& br)
+{
+	if (!ready())
+		return false;
+
+	enum { stmtCount, stmtListVideo, stmtProgInfo, stmtLiveStreams, stmtChannels };
+	vector<pair<size_t, int> > stmts;
+	string sql = "";
+	for (size_t i = 0; i < br.size(); i++) {
+		if (!br[i].error.empty())
+			continue;
+		if (br[i].queryMode == queryMode_Info) {
+			sql += progInfoSql();
+			stmts.push_back(make_pair(i, static_cast<int>(stmtProgInfo)));
+		}
+		else if (br[i].queryMode == queryMode_listLivestreams) {
+			sql += liveStreamsSql();
+			stmts.push_back(make_pair(i, static_cast<int>(stmtLiveStreams)));
+		}
+		else if (br[i].queryMode == queryMode_listChannels) {
+			sql += channelsSql();
+			stmts.push_back(make_pair(i, static_cast<int>(stmtChannels)));
+		}
+		else if (br[i].queryMode == queryMode_listVideos) {
+			string where = listVideoWhere(&br[i].clv, &br[i].lvh);
+			sql += resultCountSql(where);
+			stmts.push_back(make_pair(i, static_cast<int>(stmtCount)));
+			sql += listVideoSql(&br[i].clv, where);
+			stmts.push_back(make_pair(i, static_cast<int>(stmtListVideo)));
+		}
+	}
+	if (stmts.empty())
+		return true;
+
+	if (mysql_set_server_option(mysqlCon, MYSQL_OPTION_MULTI_STATEMENTS_ON) != 0) {
+		show_error(__func__, __LINE__);
+		return false;
+	}
+	CMultiStatementsGuard multiGuard(mysqlCon);
+
+	CStageTimer* timer = g_mainInstance->timer;
+	timer->begin(CStageTimer::stageQuery);
+	if (!query(sql)) {
+		timer->end(CStageTimer::stageQuery);
+		show_error(__func__, __LINE__);
+		return false;
+	}
+	timer->end(CStageTimer::stageQuery);
+
+	size_t n = 0;
+	int status = 0;
+	do {
+		timer->begin(CStageTimer::stageQuery);
+		MYSQL_RES* result = storeResult();
+		timer->end(CStageTimer::stageQuery);
+		if (result) {
+			timer->begin(CStageTimer::stageRowMapping);
+			if (n < stmts.size()) {
+				batchRequest_t* r = &br[stmts[n].first];
+				switch (stmts[n].second) {
+					case stmtCount:
+						r->total = fetchResultCount(result);
+						break;
+					case stmtListVideo:
+						fetchListVideo(result, r->lv);
+						setListVideoHead(&r->clv, &r->lvh, static_cast<int>(r->lv.size()), r->total);
+						break;
+					case stmtProgInfo:
+						fetchProgInfo(result, &r->pi);
+						r->pi.api		= static_cast<string>(g_progNameShort);
+						r->pi.apiversion	= static_cast<string>(g_progVersion);
+						break;
+					case stmtLiveStreams:
+						fetchLiveStreams(result, r->ls);
+						break;
+					case stmtChannels:
+						fetchChannels(result, r->ch);
+						break;
 				}
-				ch.push_back(chs);
 			}
+			timer->end(CStageTimer::stageRowMapping);
+			mysql_free_result(result);
+			n++;
 		}
-		mysql_free_result(result);
+		else if (mysql_field_count(mysqlCon) != 0) {
+			show_error(__func__, __LINE__);
+			return false;
+		}
+		status = mysql_next_result(mysqlCon);
+	} while (status == 0);
+
+	if (status > 0) {
+		show_error(__func__, __LINE__);
+		return false;
 	}
 
 	if (g_debugMode)
 		g_mainInstance->htmlOut << formatSql(sql, 1, "", "") << endl;
 
-	return true;
+	return (n == stmts.size());
 }
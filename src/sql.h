@@ -13,23 +13,29 @@
 #include <string>
 
 #include "types.h"
+#include "backend.h"
 
 using namespace std;
 
-class CSql
+/* MariaDB backend */
+class CSql : public CDbBackend
 {
 	private:
 		MYSQL *mysqlCon;
 		string pwFile;
 		string usedDB;
 		string mysqlHost;
+		int mysqlPort;
 		string tabChannelinfo;
 		string tabVersion;
 		string tabVideo;
-		int resultCount;
+		string videoColumns;
 
 		void Init();
-		void show_error(const char* func, int line);
+		void show_error(const char* func, int line, MYSQL_RES* pending=NULL);
+		void abandonResult(MYSQL_RES* result);
+		bool query(const string& sql);
+		MYSQL_RES* storeResult();
 		char checkStringBuff[0xFFFF];
 		inline string checkString(string& str, int size) {
 			size_t size_ = ((size_t)size > (sizeof(checkStringBuff)-1)) ? sizeof(checkStringBuff)-1 : size;
@@ -41,23 +47,39 @@ class CSql
 			return "'" + str + "'";
 		}
 		inline string checkInt(int i) { return to_string(i); }
-		string formatSql(string data, int id, string tagBefore="", string tagAfter="");
-		int getResultCount(string where);
-		double startTimer();
-		string getTimer(double startTime, string txt, int preci=3);
+		string explainQuery(string sql);
+		string resultCountSql(string where);
+		int fetchResultCount(MYSQL_RES* result);
+		int getResultCount(string where, cmdListVideo_t* clv=NULL);
+		string listVideoWhere(cmdListVideo_t* clv, listVideoHead_t* lvh);
+		string listVideoSql(cmdListVideo_t* clv, string where);
+		void fetchListVideo(MYSQL_RES* result, vector<listVideo_t>& lv);
+		string progInfoSql();
+		void fetchProgInfo(MYSQL_RES* result, progInfo_t* pi);
+		string liveStreamsSql();
+		void fetchLiveStreams(MYSQL_RES* result, vector<livestreams_t>& ls);
+		string channelsSql();
+		void fetchChannels(MYSQL_RES* result, vector<channels_t>& ch);
 		int row2int(MYSQL_ROW& row, uint64_t* lengths, int index);
 		bool row2bool(MYSQL_ROW& row, uint64_t* lengths, int index);
 		string row2string(MYSQL_ROW& row, uint64_t* lengths, int index);
+		void row2listVideo(MYSQL_ROW& row, uint64_t* lengths, listVideo_t* lv);
+		bool streamVideoRows(string sql, exportVideoCallback_t callback, int* rows);
 
 	public:
 		CSql();
 		~CSql();
 
 		bool connectMysql();
+		bool connect();
+		bool isConnected() { return (mysqlCon != NULL); };
 		bool sqlListVideo(cmdListVideo_t* clv, listVideoHead_t* lvh, vector<listVideo_t>& lv);
 		bool sqlGetProgInfo(progInfo_t* pi);
 		bool sqlListLiveStreams(vector<livestreams_t>& ls);
 		bool sqlListChannels(vector<channels_t>& ch);
+		bool sqlStreamVideo(cmdListVideo_t* clv, listVideoHead_t* lvh, exportVideoCallback_t callback);
+		bool sqlExportVideos(exportVideoCallback_t callback);
+		bool sqlBatch(vector<batchRequest_t>& br);
 };
 
 
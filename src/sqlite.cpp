@@ -0,0 +1,641 @@
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+#include <errno.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "common/helpers.h"
+#include "mt-api.h"
+#include "json.h"
+#include "sqlite.h"
+#include "catalog.h"
+#include "timing.h"
+#include "metrics.h"
+
+extern CMtApi*		g_mainInstance;
+extern string		g_dataRoot;
+extern string		g_cacheRoot;
+extern bool		g_debugMode;
+extern string		g_msgBoxText;
+extern const char*	g_progNameShort;
+extern const char*	g_progVersion;
+
+CSqliteDb::CSqliteDb(int src, string file) : CDbBackend()
+{
+	db		= NULL;
+	source		= src;
+	dbFile		= file;
+	if (dbFile.empty() && (source == sourceFile))
+		dbFile = g_dataRoot + "/mediathek.sqlite";
+	videoColumns	= "";
+	videoColumns	+= " channel, theme, title, description, website, subtitle, url, url_small, url_hd, url_rtmp,";
+	videoColumns	+= " url_rtmp_small, url_rtmp_hd, url_history, date_unix, duration, size_mb, geo, parse_m3u8";
+}
+
+CSqliteDb::~CSqliteDb()
+{
+	if (db != NULL)
+		sqlite3_close(db);
+}
+
+void CSqliteDb::show_error(const char* func, int line)
+{
+	std::ostringstream oss;
+	oss << "<span style='color: OrangeRed'>[" << func << ':' << line
+	    << "] SQLite error(" << ((db != NULL) ? sqlite3_errcode(db) : 0) << ") \""
+	    << ((db != NULL) ? sqlite3_errmsg(db) : "no database") << "\" (" << dbFile
+	    << ")\n<br /></span>";
+	g_msgBoxText = oss.str();
+	g_mainInstance->metrics->countDbError();
+}
+
+bool CSqliteDb::exec(string sql)
+{
+	return (sqlite3_exec(db, sql.c_str(), NULL, NULL, NULL) == SQLITE_OK);
+}
+
+sqlite3_stmt* CSqliteDb::prepare(string sql)
+{
+	sqlite3_stmt* stmt = NULL;
+	if (sqlite3_prepare_v2(db, sql.c_str(), static_cast<int>(sql.length()), &stmt, NULL) != SQLITE_OK)
+		return NULL;
+	return stmt;
+}
+
+bool CSqliteDb::connect()
+{
+	if (db != NULL)
+		return true;
+	if (dbFile.empty()) {
+		g_msgBoxText = "<span style='color: OrangeRed'>No database file (MT_API_DB_FILE) given.\n<br /></span>";
+		return false;
+	}
+
+	if (!((source == sourceCatalog) ? loadCatalog() : openFile()))
+		return false;
+
+	/* queries running past the request deadline are interrupted (SQLITE_INTERRUPT) */
+	sqlite3_progress_handler(db, 1000, deadlineHandler, this);
+	return true;
+}
+
+int CSqliteDb::deadlineHandler(void* data)
+{
+	return (static_cast<CSqliteDb*>(data)->timeLeftMs() <= 0) ? 1 : 0;
+}
+
+bool CSqliteDb::openFile()
+{
+	if (sqlite3_open_v2(dbFile.c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK) {
+		show_error(__func__, __LINE__);
+		sqlite3_close(db);
+		db = NULL;
+		return false;
+	}
+	sqlite3_busy_timeout(db, 2000);
+	return true;
+}
+
+/* the imported catalog written by an earlier request */
+bool CSqliteDb::openCache(string cacheFile)
+{
+	if (!file_exists(cacheFile.c_str()))
+		return false;
+	string dumpFile = dbFile;
+	dbFile = cacheFile;
+	if (openFile())
+		return true;
+	dbFile = dumpFile;
+	return false;
+}
+
+/* the import lock, waited for until the request deadline */
+bool CSqliteDb::lockImport(int fd)
+{
+	struct timespec pause = { 0, 10 * 1000000L };
+	while (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+		if ((errno != EWOULDBLOCK) && (errno != EINTR))
+			return false;
+		if (timeLeftMs() <= 0)
+			return false;
+		nanosleep(&pause, NULL);
+	}
+	return true;
+}
+
+/*
+ * Load a catalog dump into an in-memory database. The result is kept as
+ * <cacheRoot>/sqlite/catalog-<version>.sqlite, so only the first request
+ * after a new dump pays for the import. Imports are serialized by
+ * <cacheRoot>/sqlite/import.lock like CCatalog::update(): requests
+ * arriving meanwhile wait and open the file the first one wrote. Waiting
+ * and importing are bounded by the request deadline.
+ */
+bool CSqliteDb::loadCatalog()
+{
+	CCatalogReader reader;
+	int64_t ver = 0;
+	if (!reader.open(dbFile) || !reader.beginDump(&ver)) {
+		g_msgBoxText = "<span style='color: OrangeRed'>Can't read catalog dump " + dbFile + "\n<br /></span>";
+		return false;
+	}
+
+	string cacheDir  = g_cacheRoot + "/sqlite";
+	string cacheName = "catalog-" + to_string(static_cast<long long>(ver)) + ".sqlite";
+	string cacheFile = cacheDir + "/" + cacheName;
+	if (openCache(cacheFile)) {
+		g_mainInstance->metrics->countCache(CMetrics::cacheSqlite, true);
+		return true;
+	}
+
+	mkdir(g_cacheRoot.c_str(), 0755);
+	mkdir(cacheDir.c_str(), 0755);
+	string lockFile = cacheDir + "/import.lock";
+	int lockFd = open(lockFile.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+	/* without the lock (cache not writable) every request imports on its own */
+	if ((lockFd >= 0) && !lockImport(lockFd)) {
+		close(lockFd);
+		g_msgBoxText = "<span style='color: OrangeRed'>Request deadline exceeded while the catalog is imported.\n<br /></span>";
+		return false;
+	}
+
+	bool hit = openCache(cacheFile);
+	g_mainInstance->metrics->countCache(CMetrics::cacheSqlite, hit);
+	bool ret = hit || importCatalog(reader, ver, cacheDir, cacheName);
+	if (lockFd >= 0)
+		close(lockFd);
+	return ret;
+}
+
+bool CSqliteDb::importCatalog(CCatalogReader& reader, int64_t ver, string cacheDir, string cacheName)
+{
+	string cacheFile = cacheDir + "/" + cacheName;
+	if (sqlite3_open(":memory:", &db) != SQLITE_OK) {
+		show_error(__func__, __LINE__);
+		sqlite3_close(db);
+		db = NULL;
+		return false;
+	}
+	sqlite3_progress_handler(db, 1000, deadlineHandler, this);
+
+	string sql = "";
+	sql += "CREATE TABLE video (id INTEGER PRIMARY KEY, channel TEXT, theme TEXT, title TEXT, description TEXT,";
+	sql += " website TEXT, subtitle TEXT, url TEXT, url_small TEXT, url_hd TEXT, url_rtmp TEXT, url_rtmp_small TEXT,";
+	sql += " url_rtmp_hd TEXT, url_history TEXT, date_unix INTEGER, duration INTEGER, size_mb INTEGER, geo TEXT,";
+	sql += " parse_m3u8 INTEGER);";
+	sql += "CREATE TABLE version (version TEXT, vdate INTEGER, mvversion TEXT, mvdate INTEGER, mventrys INTEGER,";
+	sql += " progname TEXT, progversion TEXT);";
+	sql += "CREATE TABLE channelinfo (channel TEXT, count INTEGER, latest INTEGER, oldest INTEGER);";
+	if (!exec(sql) || !exec("BEGIN;")) {
+		show_error(__func__, __LINE__);
+		sqlite3_close(db);
+		db = NULL;
+		return false;
+	}
+
+	sqlite3_stmt* stmt = prepare("INSERT INTO video (" + videoColumns + ") VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?);");
+	if (stmt == NULL) {
+		show_error(__func__, __LINE__);
+		sqlite3_close(db);
+		db = NULL;
+		return false;
+	}
+	bool ok = true;
+	uint64_t count = 0;
+	string record;
+	bool end = false;
+	while (ok && reader.readRecord(record, &end) && !end) {
+		listVideo_t lv;
+		g_mainInstance->cjson->resetListVideoStruct(&lv);
+		if (!CCatalog::decodeRecord(record, &lv)) {
+			ok = false;
+			break;
+		}
+		const string* text[] = { &lv.channel, &lv.theme, &lv.title, &lv.description, &lv.website, &lv.subtitle,
+					 &lv.url, &lv.url_small, &lv.url_hd, &lv.url_rtmp, &lv.url_rtmp_small,
+					 &lv.url_rtmp_hd, &lv.url_history };
+		int index = 1;
+		for (size_t i = 0; i < sizeof(text) / sizeof(text[0]); i++, index++)
+			sqlite3_bind_text(stmt, index, text[i]->c_str(), static_cast<int>(text[i]->length()), SQLITE_STATIC);
+		sqlite3_bind_int64(stmt, index++, lv.date_unix);
+		sqlite3_bind_int64(stmt, index++, lv.duration);
+		sqlite3_bind_int64(stmt, index++, lv.size_mb);
+		sqlite3_bind_text(stmt, index++, lv.geo.c_str(), static_cast<int>(lv.geo.length()), SQLITE_STATIC);
+		sqlite3_bind_int64(stmt, index++, lv.parse_m3u8);
+		ok = (sqlite3_step(stmt) == SQLITE_DONE);
+		sqlite3_reset(stmt);
+		count++;
+	}
+	sqlite3_finalize(stmt);
+	uint64_t trailer = 0;
+	ok = ok && end && reader.readVarint(&trailer) && (trailer == count);
+	reader.close();
+	if (!ok && (timeLeftMs() <= 0)) {
+		g_msgBoxText = "<span style='color: OrangeRed'>Request deadline exceeded while the catalog is imported.\n<br /></span>";
+		sqlite3_close(db);
+		db = NULL;
+		return false;
+	}
+	if (!ok) {
+		g_msgBoxText = "<span style='color: OrangeRed'>Catalog dump " + dbFile + " is damaged.\n<br /></span>";
+		sqlite3_close(db);
+		db = NULL;
+		return false;
+	}
+
+	string v = to_string(static_cast<long long>(ver));
+	sql  = "INSERT INTO version VALUES ('', " + v + ", '', " + v + ", " + to_string(static_cast<unsigned long long>(count)) + ", '', '');";
+	sql += "INSERT INTO channelinfo SELECT channel, COUNT(*), MAX(date_unix), MIN(date_unix) FROM video GROUP BY channel;";
+	sql += "CREATE INDEX video_channel ON video (channel COLLATE NOCASE);";
+	sql += "CREATE INDEX video_date_unix ON video (date_unix);";
+	sql += "COMMIT;";
+	if (!exec(sql)) {
+		show_error(__func__, __LINE__);
+		sqlite3_close(db);
+		db = NULL;
+		return false;
+	}
+
+	/* best effort: write the cache file next to a temporary name, then rename */
+	string tmpFile = cacheFile + "." + to_string(static_cast<int>(getpid()));
+	sqlite3* fileDb = NULL;
+	if (sqlite3_open(tmpFile.c_str(), &fileDb) == SQLITE_OK) {
+		sqlite3_backup* backup = sqlite3_backup_init(fileDb, "main", db, "main");
+		bool saved = (backup != NULL) && (sqlite3_backup_step(backup, -1) == SQLITE_DONE);
+		if (backup != NULL)
+			sqlite3_backup_finish(backup);
+		sqlite3_close(fileDb);
+		if (saved && (rename(tmpFile.c_str(), cacheFile.c_str()) == 0)) {
+			/* drop the caches of older dumps */
+			DIR* dir = opendir(cacheDir.c_str());
+			if (dir != NULL) {
+				struct dirent* entry;
+				while ((entry = readdir(dir)) != NULL) {
+					string name = entry->d_name;
+					if ((name.compare(0, 8, "catalog-") == 0) && (name != cacheName))
+						unlink((cacheDir + "/" + name).c_str());
+				}
+				closedir(dir);
+			}
+		}
+		else
+			unlink(tmpFile.c_str());
+	}
+	else
+		sqlite3_close(fileDb);
+
+	return true;
+}
+
+/* EXPLAIN QUERY PLAN of a statement as text, one line per plan row */
+string CSqliteDb::explainQuery(string sql)
+{
+	sqlite3_stmt* stmt = prepare("EXPLAIN QUERY PLAN " + sql);
+	if (stmt == NULL)
+		return string("EXPLAIN failed: ") + sqlite3_errmsg(db);
+
+	string ret = "";
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		int fieldCount = sqlite3_column_count(stmt);
+		for (int i = 0; i < fieldCount; i++) {
+			if (i > 0)
+				ret += " ";
+			const char* val = reinterpret_cast<const char*>(sqlite3_column_text(stmt, i));
+			ret += string(sqlite3_column_name(stmt, i)) + "=" + ((val != NULL) ? val : "NULL");
+		}
+		ret += "\n";
+	}
+	sqlite3_finalize(stmt);
+	return ret;
+}
+
+string CSqliteDb::col2string(sqlite3_stmt* stmt, int index)
+{
+	const char* val = reinterpret_cast<const char*>(sqlite3_column_text(stmt, index));
+	if (val == NULL)
+		return "";
+	return string(val, sqlite3_column_bytes(stmt, index));
+}
+
+void CSqliteDb::row2listVideo(sqlite3_stmt* stmt, listVideo_t* lv)
+{
+	g_mainInstance->cjson->resetListVideoStruct(lv);
+
+	int index = 0;
+	lv->channel		= col2string(stmt, index++);
+	lv->theme		= col2string(stmt, index++);
+	lv->title		= col2string(stmt, index++);
+	lv->description		= col2string(stmt, index++);
+	lv->website		= col2string(stmt, index++);
+	lv->subtitle		= col2string(stmt, index++);
+	lv->url			= col2string(stmt, index++);
+	lv->url_small		= col2string(stmt, index++);
+	lv->url_hd		= col2string(stmt, index++);
+	lv->url_rtmp		= col2string(stmt, index++);
+	lv->url_rtmp_small	= col2string(stmt, index++);
+	lv->url_rtmp_hd		= col2string(stmt, index++);
+	lv->url_history		= col2string(stmt, index++);
+	lv->date_unix		= sqlite3_column_int64(stmt, index++);
+	lv->duration		= sqlite3_column_int(stmt, index++);
+	lv->size_mb		= sqlite3_column_int(stmt, index++);
+	lv->geo			= col2string(stmt, index++);
+	lv->parse_m3u8		= sqlite3_column_int(stmt, index++);
+}
+
+/* Same filter as CSql::listVideoWhere(), the values are bound as ?1..?4 */
+string CSqliteDb::listVideoWhere(int range)
+{
+	string where = "";
+	where += " WHERE ( channel LIKE ?1";
+	where += " AND duration >= ?2";
+	if (range != rangeNone)
+		where += " AND date_unix < ?3";
+	if (range == rangeBetween)
+		where += " AND date_unix > ?4";
+	where += " )";
+
+	return where;
+}
+
+void CSqliteDb::bindListVideo(sqlite3_stmt* stmt, cmdListVideo_t* clv, time_t fromTime, time_t toTime)
+{
+	string channel = clv->channel.substr(0, 128);
+	sqlite3_bind_text(stmt, 1, channel.c_str(), static_cast<int>(channel.length()), SQLITE_TRANSIENT);
+	sqlite3_bind_int(stmt, 2, clv->duration);
+	/* parameters not used by the statement are ignored (SQLITE_RANGE) */
+	sqlite3_bind_int64(stmt, 3, fromTime);
+	sqlite3_bind_int64(stmt, 4, toTime);
+}
+
+int CSqliteDb::getResultCount(cmdListVideo_t* clv, int range, time_t fromTime, time_t toTime)
+{
+	string sql = "SELECT COUNT(*) AS anz FROM video" + listVideoWhere(range) + ";";
+
+	CStageTimer* timer = g_mainInstance->timer;
+	timer->begin(CStageTimer::stageCountQuery);
+	int64_t queryStart = CStageTimer::now();
+
+	sqlite3_stmt* stmt = prepare(sql);
+	if (stmt == NULL) {
+		timer->end(CStageTimer::stageCountQuery);
+		show_error(__func__, __LINE__);
+		return 0;
+	}
+	bindListVideo(stmt, clv, fromTime, toTime);
+	int rc = sqlite3_step(stmt);
+	int ret = (rc == SQLITE_ROW) ? sqlite3_column_int(stmt, 0) : 0;
+	sqlite3_finalize(stmt);
+
+	timer->end(CStageTimer::stageCountQuery);
+	/* interrupted at the deadline or failed: no count rather than 0 */
+	if (rc != SQLITE_ROW) {
+		show_error(__func__, __LINE__);
+		return -1;
+	}
+
+	if (g_debugMode)
+		g_mainInstance->htmlOut << formatSql(sql, 1, "", "") << endl;
+	checkQuery(sql, 1, CStageTimer::now() - queryStart, ret, clv);
+
+	return ret;
+}
+
+bool CSqliteDb::sqlListVideo(cmdListVideo_t* clv, listVideoHead_t* lvh, vector<listVideo_t>& lv)
+{
+	if (!ready())
+		return false;
+
+	time_t fromTime, toTime;
+	int range = listVideoRange(clv, lvh, &fromTime, &toTime);
+	resultCount = getResultCount(clv, range, fromTime, toTime);
+	if (resultCount < 0) {
+		resultCount = 0;
+		return false;
+	}
+
+	string sql = "";
+	sql += "SELECT * FROM ( ";
+	sql += "SELECT" + videoColumns;
+	sql += " FROM video";
+	sql += listVideoWhere(range);
+	sql += " ORDER BY date_unix DESC";
+	sql += " LIMIT ?5 OFFSET ?6";
+	sql += " ) AS dingens";
+	sql += " ORDER BY date_unix DESC, title ASC;";
+
+	CStageTimer* timer = g_mainInstance->timer;
+	timer->begin(CStageTimer::stagePageQuery);
+	int64_t queryStart = CStageTimer::now();
+	size_t rowsBefore = lv.size();
+	sqlite3_stmt* stmt = prepare(sql);
+	if (stmt == NULL) {
+		timer->end(CStageTimer::stagePageQuery);
+		show_error(__func__, __LINE__);
+		return false;
+	}
+	bindListVideo(stmt, clv, fromTime, toTime);
+	sqlite3_bind_int(stmt, 5, clv->limit);
+	sqlite3_bind_int(stmt, 6, clv->start);
+
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		listVideo_t lvv;
+		timer->begin(CStageTimer::stageRowMapping);
+		row2listVideo(stmt, &lvv);
+		timer->end(CStageTimer::stageRowMapping);
+		lv.push_back(lvv);
+		rowCount++;
+	}
+	sqlite3_finalize(stmt);
+	timer->end(CStageTimer::stagePageQuery);
+	if (rc != SQLITE_DONE) {
+		show_error(__func__, __LINE__);
+		return false;
+	}
+
+	setListVideoHead(clv, lvh, static_cast<int>(lv.size()), resultCount);
+
+	if (g_debugMode)
+		g_mainInstance->htmlOut << formatSql(sql, 2, "", "") << endl;
+	checkQuery(sql, 2, CStageTimer::now() - queryStart, lv.size() - rowsBefore, clv);
+
+	return true;
+}
+
+bool CSqliteDb::sqlExportVideos(exportVideoCallback_t callback)
+{
+	if (!ready())
+		return false;
+
+	string sql = "";
+	sql += "SELECT" + videoColumns;
+	sql += " FROM video";
+	sql += " ORDER BY channel ASC, date_unix DESC, title ASC;";
+
+	sqlite3_stmt* stmt = prepare(sql);
+	if (stmt == NULL) {
+		show_error(__func__, __LINE__);
+		return false;
+	}
+
+	bool ret = true;
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		listVideo_t lvv;
+		row2listVideo(stmt, &lvv);
+		rowCount++;
+		if (!callback(&lvv)) {
+			ret = false;
+			break;
+		}
+	}
+	sqlite3_finalize(stmt);
+	if (ret && (rc != SQLITE_DONE)) {
+		show_error(__func__, __LINE__);
+		return false;
+	}
+
+	return ret;
+}
+
+bool CSqliteDb::sqlGetProgInfo(progInfo_t* pi)
+{
+	if (!ready())
+		return false;
+
+	string sql = "";
+	sql += "SELECT version, vdate, mvversion, mvdate, mventrys, progname, progversion";
+	sql += " FROM version";
+	sql += " LIMIT 1;";
+
+	CStageTimer* timer = g_mainInstance->timer;
+	timer->begin(CStageTimer::stageQuery);
+	sqlite3_stmt* stmt = prepare(sql);
+	if (stmt == NULL) {
+		timer->end(CStageTimer::stageQuery);
+		show_error(__func__, __LINE__);
+		return false;
+	}
+	int rc = sqlite3_step(stmt);
+	if (rc == SQLITE_ROW) {
+		int index = 0;
+		pi->version	= col2string(stmt, index++);
+		pi->vdate	= sqlite3_column_int64(stmt, index++);
+		pi->mvversion	= col2string(stmt, index++);
+		pi->mvdate	= sqlite3_column_int64(stmt, index++);
+		pi->mventrys	= sqlite3_column_int(stmt, index++);
+		pi->progname	= col2string(stmt, index++);
+		pi->progversion	= col2string(stmt, index++);
+		rowCount++;
+	}
+	sqlite3_finalize(stmt);
+	timer->end(CStageTimer::stageQuery);
+	if ((rc != SQLITE_ROW) && (rc != SQLITE_DONE)) {
+		show_error(__func__, __LINE__);
+		return false;
+	}
+
+	if (g_debugMode)
+		g_mainInstance->htmlOut << formatSql(sql, 1, "", "") << endl;
+
+	pi->api		= static_cast<string>(g_progNameShort);
+	pi->apiversion	= static_cast<string>(g_progVersion);
+	return true;
+}
+
+bool CSqliteDb::sqlListLiveStreams(vector<livestreams_t>& ls)
+{
+	if (!ready())
+		return false;
+
+	string sql = "";
+	sql += "SELECT title, url, parse_m3u8";
+	sql += " FROM video";
+	sql += " WHERE (theme LIKE 'Livestream' AND title LIKE '%Livestream%')";
+	sql += " ORDER BY channel, title ASC";
+	sql += " LIMIT 50;";
+
+	CStageTimer* timer = g_mainInstance->timer;
+	timer->begin(CStageTimer::stageQuery);
+	sqlite3_stmt* stmt = prepare(sql);
+	if (stmt == NULL) {
+		timer->end(CStageTimer::stageQuery);
+		show_error(__func__, __LINE__);
+		return false;
+	}
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		livestreams_t lss;
+		g_mainInstance->cjson->resetLiveStreamStruct(&lss);
+		int index = 0;
+		lss.title	= col2string(stmt, index++);
+		lss.url		= col2string(stmt, index++);
+		lss.parse_m3u8	= sqlite3_column_int(stmt, index++);
+		ls.push_back(lss);
+		rowCount++;
+	}
+	sqlite3_finalize(stmt);
+	timer->end(CStageTimer::stageQuery);
+	/* interrupted at the deadline: a partial list is no answer */
+	if (rc != SQLITE_DONE) {
+		show_error(__func__, __LINE__);
+		return false;
+	}
+
+	if (g_debugMode)
+		g_mainInstance->htmlOut << formatSql(sql, 1, "", "") << endl;
+
+	return true;
+}
+
+bool CSqliteDb::sqlListChannels(vector<channels_t>& ch)
+{
+	if (!ready())
+		return false;
+
+	string sql = "";
+	sql += "SELECT channel, count, latest, oldest";
+	sql += " FROM channelinfo";
+	sql += " ORDER BY channel ASC";
+	sql += " LIMIT 50;";
+
+	CStageTimer* timer = g_mainInstance->timer;
+	timer->begin(CStageTimer::stageQuery);
+	sqlite3_stmt* stmt = prepare(sql);
+	if (stmt == NULL) {
+		timer->end(CStageTimer::stageQuery);
+		show_error(__func__, __LINE__);
+		return false;
+	}
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		channels_t chs;
+		g_mainInstance->cjson->resetChannelStruct(&chs);
+		int index = 0;
+		chs.channel	= col2string(stmt, index++);
+		chs.count	= sqlite3_column_int(stmt, index++);
+		chs.latest	= sqlite3_column_int(stmt, index++);
+		chs.oldest	= sqlite3_column_int(stmt, index++);
+		ch.push_back(chs);
+		rowCount++;
+	}
+	sqlite3_finalize(stmt);
+	timer->end(CStageTimer::stageQuery);
+	/* interrupted at the deadline: a partial list is no answer */
+	if (rc != SQLITE_DONE) {
+		show_error(__func__, __LINE__);
+		return false;
+	}
+
+	if (g_debugMode)
+		g_mainInstance->htmlOut << formatSql(sql, 1, "", "") << endl;
+
+	return true;
+}
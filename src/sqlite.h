@@ -0,0 +1,72 @@
+
+#ifndef __SQLITE_H__
+#define __SQLITE_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sqlite3.h>
+
+#include <string>
+
+#include "types.h"
+#include "backend.h"
+
+class CCatalogReader;
+
+using namespace std;
+
+/*
+ * SQLite backend, read-only. Serves a SQLite file with the tables of the
+ * MariaDB database (video, version, channelinfo) or a catalog dump
+ * (catalog-<version>.mtc.gz), which is loaded into an in-memory database
+ * on connect().
+ */
+class CSqliteDb : public CDbBackend
+{
+	public:
+		enum {
+			sourceFile,
+			sourceCatalog
+		};
+
+	private:
+		sqlite3* db;
+		int source;
+		string dbFile;
+		string videoColumns;
+
+		void show_error(const char* func, int line);
+		bool exec(string sql);
+		sqlite3_stmt* prepare(string sql);
+		bool openFile();
+		bool openCache(string cacheFile);
+		bool lockImport(int fd);
+		bool loadCatalog();
+		bool importCatalog(CCatalogReader& reader, int64_t ver, string cacheDir, string cacheName);
+		static int deadlineHandler(void* data);
+		string explainQuery(string sql);
+		string col2string(sqlite3_stmt* stmt, int index);
+		void row2listVideo(sqlite3_stmt* stmt, listVideo_t* lv);
+		string listVideoWhere(int range);
+		void bindListVideo(sqlite3_stmt* stmt, cmdListVideo_t* clv, time_t fromTime, time_t toTime);
+		int getResultCount(cmdListVideo_t* clv, int range, time_t fromTime, time_t toTime);
+
+	public:
+		CSqliteDb(int src, string file);
+		~CSqliteDb();
+
+		bool connect();
+		bool isConnected() { return (db != NULL); };
+		bool sqlListVideo(cmdListVideo_t* clv, listVideoHead_t* lvh, vector<listVideo_t>& lv);
+		bool sqlGetProgInfo(progInfo_t* pi);
+		bool sqlListLiveStreams(vector<livestreams_t>& ls);
+		bool sqlListChannels(vector<channels_t>& ch);
+		bool sqlExportVideos(exportVideoCallback_t callback);
+};
+
+
+#endif // __SQLITE_H__
@@ -0,0 +1,118 @@
+
+#include <iostream>
+#include <string>
+
+#include "template.h"
+#ifndef MT_API_TEMPLATE_PARSER_ONLY
+#include "filecache.h"
+#endif
+
+static const char	placeholderMark[] = "@@@";
+static const size_t	placeholderMarkLen = sizeof(placeholderMark) - 1;
+
+static bool isPlaceholderChar(char c)
+{
+	return (((c >= 'A') && (c <= 'Z')) || ((c >= '0') && (c <= '9')) || (c == '_'));
+}
+
+/*
+ * Splits text into literal and placeholder segments. Only @@@NAME@@@
+ * with NAME out of [A-Z0-9_] is a placeholder, anything else stays text.
+ */
+bool CTemplate::parse(const char* text, size_t len, vector<segment_t>& segments)
+{
+	segments.clear();
+	if (len > UINT32_MAX)
+		return false;
+
+	size_t literal = 0;
+	size_t pos = 0;
+	while (pos + 2 * placeholderMarkLen < len) {
+		const char* begin = static_cast<const char*>(memmem(text + pos, len - pos, placeholderMark, placeholderMarkLen));
+		if (begin == NULL)
+			break;
+		size_t name = (begin - text) + placeholderMarkLen;
+		size_t end = name;
+		while ((end < len) && isPlaceholderChar(text[end]))
+			end++;
+		if ((end == name) || (end + placeholderMarkLen > len) || (memcmp(text + end, placeholderMark, placeholderMarkLen) != 0)) {
+			pos = name - placeholderMarkLen + 1;
+			continue;
+		}
+
+		size_t mark = name - placeholderMarkLen;
+		if (mark > literal)
+			segments.push_back({ static_cast<uint32_t>(literal), static_cast<uint32_t>(mark - literal), false });
+		segments.push_back({ static_cast<uint32_t>(name), static_cast<uint32_t>(end - name), true });
+		literal = end + placeholderMarkLen;
+		pos = literal;
+	}
+	if (len > literal)
+		segments.push_back({ static_cast<uint32_t>(literal), static_cast<uint32_t>(len - literal), false });
+
+	return true;
+}
+
+#ifndef MT_API_TEMPLATE_PARSER_ONLY
+CTemplate::CTemplate()
+{
+	/* MT_API_TEMPLATE_DIR: read the templates from disk (e.g. src/web/data/template) */
+	const char* dirEnv = getenv("MT_API_TEMPLATE_DIR");
+	templateDir = (dirEnv && *dirEnv) ? dirEnv : "";
+}
+
+void CTemplate::renderSegments(string& out, const char* text, const segment_t* segments, size_t count, const initializer_list<var_t>& vars)
+{
+	size_t size = 0;
+	for (size_t i = 0; i < count; i++)
+		size += segments[i].len;
+	for (const var_t& v : vars)
+		size += v.value.length();
+	out.reserve(size);
+
+	for (size_t i = 0; i < count; i++) {
+		const segment_t& s = segments[i];
+		if (!s.var) {
+			out.append(text + s.pos, s.len);
+			continue;
+		}
+
+		const string* value = NULL;
+		for (const var_t& v : vars) {
+			if ((strlen(v.name) == s.len) && (memcmp(v.name, text + s.pos, s.len) == 0)) {
+				value = &v.value;
+				break;
+			}
+		}
+		/* no value: keep the placeholder */
+		if (value != NULL)
+			out.append(*value);
+		else
+			out.append(text + s.pos - placeholderMarkLen, s.len + 2 * placeholderMarkLen);
+	}
+}
+
+string CTemplate::render(const char* name, initializer_list<var_t> vars/*={}*/)
+{
+	string ret = "";
+	if (!templateDir.empty()) {
+		CFileCache::view_t view;
+		vector<segment_t> segments;
+		if (g_fileCache.get(templateDir + "/" + name, &view) && parse(view.data, view.size, segments)) {
+			renderSegments(ret, view.data, segments.data(), segments.size(), vars);
+			return ret;
+		}
+	}
+
+	for (size_t i = 0; i < g_templateCount; i++) {
+		const compiled_t& t = g_templates[i];
+		if (strcmp(t.name, name) == 0) {
+			renderSegments(ret, t.text, t.segments, t.segmentCount, vars);
+			return ret;
+		}
+	}
+
+	cerr << "Unknown template " << name << endl;
+	return ret;
+}
+#endif // MT_API_TEMPLATE_PARSER_ONLY
@@ -0,0 +1,71 @@
+
+#ifndef __TEMPLATE_H__
+#define __TEMPLATE_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <initializer_list>
+
+using namespace std;
+
+/*
+ * HTML templates (src/web/data/template) with @@@NAME@@@ placeholders.
+ * The templates are compiled into the binary by mt-api-gentpl, split
+ * into segments: literal text and placeholders, given as offset and
+ * length into the template text. render() is a single pass over the
+ * segments. With MT_API_TEMPLATE_DIR set the templates are read from
+ * that directory and split on every call instead (development).
+ */
+class CTemplate
+{
+	public:
+		typedef struct {
+			uint32_t pos;
+			uint32_t len;
+			bool var;	/* placeholder, pos/len is the name without @@@ */
+		} segment_t;
+
+		typedef struct {
+			const char* name;
+			const char* text;
+			size_t textLen;
+			const segment_t* segments;
+			size_t segmentCount;
+		} compiled_t;
+
+		typedef struct {
+			const char* name;
+			const string& value;
+		} var_t;
+
+		static bool parse(const char* text, size_t len, vector<segment_t>& segments);
+
+#ifndef MT_API_TEMPLATE_PARSER_ONLY
+	private:
+		string templateDir;
+
+		void renderSegments(string& out, const char* text, const segment_t* segments, size_t count, const initializer_list<var_t>& vars);
+
+	public:
+		CTemplate();
+		~CTemplate() {};
+
+		string render(const char* name, initializer_list<var_t> vars={});
+		bool isLive() { return !templateDir.empty(); };
+#endif // MT_API_TEMPLATE_PARSER_ONLY
+};
+
+#ifndef MT_API_TEMPLATE_PARSER_ONLY
+/* generated: build/src/templates-data.cpp */
+extern const CTemplate::compiled_t	g_templates[];
+extern const size_t			g_templateCount;
+#endif // MT_API_TEMPLATE_PARSER_ONLY
+
+
+#endif // __TEMPLATE_H__
@@ -0,0 +1,81 @@
+
+#include <sys/types.h>
+
+#include <string>
+
+#include "timing.h"
+
+CStageTimer::CStageTimer()
+{
+	startTime = now();
+	memset(stages, 0, sizeof(stages));
+	for (int i = 0; i < stageCount; i++)
+		stages[i].first = -1;
+
+	/* request id: wall clock and pid, unique enough to find a request in the logs */
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	uint64_t id = (static_cast<uint64_t>(ts.tv_sec) << 30) ^ static_cast<uint64_t>(ts.tv_nsec) ^ (static_cast<uint64_t>(getpid()) << 44);
+	char tmp[24];
+	snprintf(tmp, sizeof(tmp), "%016llx", static_cast<unsigned long long>(id));
+	requestId = tmp;
+}
+
+int64_t CStageTimer::now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+const char* CStageTimer::stageName(int stage)
+{
+	switch (stage) {
+		case stageEnv:		return "env";
+		case stagePostRead:	return "post";
+		case stageConnect:	return "connect";
+		case stageJsonParse:	return "json";
+		case stageCountQuery:	return "count";
+		case stagePageQuery:	return "page";
+		case stageQuery:	return "query";
+		case stageRowMapping:	return "rows";
+		case stageSerialize:	return "serialize";
+		case stageOutput:	return "output";
+		default:		return "unknown";
+	}
+}
+
+void CStageTimer::begin(int stage)
+{
+	if ((stage < 0) || (stage >= stageCount))
+		return;
+	if (stages[stage].depth++ > 0)
+		return;
+	int64_t t = now() - startTime;
+	stages[stage].running = t;
+	if (stages[stage].first < 0)
+		stages[stage].first = t;
+}
+
+void CStageTimer::end(int stage)
+{
+	if ((stage < 0) || (stage >= stageCount) || (stages[stage].depth == 0))
+		return;
+	if (--stages[stage].depth > 0)
+		return;
+	stages[stage].duration += now() - startTime - stages[stage].running;
+	stages[stage].calls++;
+}
+
+/* take over an id given by the client or a proxy (X-Request-Id), if it is sane */
+void CStageTimer::setRequestId(string id)
+{
+	if (id.empty() || (id.length() > 64))
+		return;
+	for (size_t i = 0; i < id.length(); i++) {
+		char c = id[i];
+		if (!isalnum(static_cast<unsigned char>(c)) && (c != '-') && (c != '_') && (c != '.'))
+			return;
+	}
+	requestId = id;
+}
@@ -0,0 +1,81 @@
+
+#ifndef __TIMING_H__
+#define __TIMING_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <string>
+
+using namespace std;
+
+/*
+ * Monotonic stage timers for one request. Times are nanoseconds since
+ * the timer was created; a stage entered several times accumulates,
+ * nested begin/end pairs of the same stage count once.
+ */
+class CStageTimer
+{
+	public:
+		enum {
+			stageEnv,
+			stagePostRead,
+			stageConnect,
+			stageJsonParse,
+			stageCountQuery,
+			stagePageQuery,
+			stageQuery,
+			stageRowMapping,
+			stageSerialize,
+			stageOutput,
+			stageCount
+		};
+
+	private:
+		struct stage_t {
+			int64_t first;
+			int64_t duration;
+			int64_t running;
+			int depth;
+			int calls;
+		};
+
+		int64_t startTime;
+		stage_t stages[stageCount];
+		string requestId;
+
+	public:
+		CStageTimer();
+
+		static int64_t now();
+		static const char* stageName(int stage);
+
+		void begin(int stage);
+		void end(int stage);
+		int64_t elapsed() { return now() - startTime; };
+		int64_t getFirst(int stage) { return stages[stage].first; };
+		int64_t getDuration(int stage) { return stages[stage].duration; };
+		int getCalls(int stage) { return stages[stage].calls; };
+
+		void setRequestId(string id);
+		string getRequestId() { return requestId; };
+};
+
+/* Times the enclosing scope */
+class CStageScope
+{
+	private:
+		CStageTimer* timer;
+		int stage;
+
+	public:
+		CStageScope(CStageTimer* timer_, int stage_) { timer = timer_; stage = stage_; if (timer != NULL) timer->begin(stage); };
+		~CStageScope() { if (timer != NULL) timer->end(stage); };
+};
+
+
+#endif // __TIMING_H__
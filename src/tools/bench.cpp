@@ -0,0 +1,259 @@
+
+#include <sys/types.h>
+#include <time.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <new>
+
+#include <jsoncpp/json/json.h>
+
+#include "mt-api.h"
+#include "net.h"
+#include "json.h"
+#include "template.h"
+#include "filecache.h"
+#include "workpool.h"
+#include "common/helpers.h"
+
+extern CMtApi*		g_mainInstance;
+
+/*
+ * Micro benchmarks for the CPU hot paths (make bench). Each benchmark
+ * runs until about benchTime has passed and reports ns/op, heap
+ * allocations/op and allocated bytes/op. An argument filters the
+ * benchmarks by name.
+ */
+
+/* counting replacements of the global allocator, kept out of line */
+static atomic<uint64_t> allocCount(0);
+static atomic<uint64_t> allocBytes(0);
+
+__attribute__((noinline)) void* operator new(size_t size)
+{
+	allocCount.fetch_add(1, memory_order_relaxed);
+	allocBytes.fetch_add(size, memory_order_relaxed);
+	void* p = malloc((size > 0) ? size : 1);
+	if (p == NULL)
+		throw bad_alloc();
+	return p;
+}
+
+__attribute__((noinline)) void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+
+/* results go here, so the compiler can't drop the work */
+static volatile size_t g_sink;
+
+static const int64_t benchTime = 300000000LL; /* ns */
+
+static int64_t nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+template <typename F>
+static void bench(const string& filter, const char* name, F fn)
+{
+	if (!filter.empty() && (string(name).find(filter) == string::npos))
+		return;
+
+	/* warm up, then grow the batch until it takes about 10 ms */
+	fn();
+	uint64_t iter = 1;
+	for (;;) {
+		int64_t start = nowNs();
+		for (uint64_t i = 0; i < iter; i++)
+			fn();
+		if ((nowNs() - start > 10000000LL) || (iter >= (1ULL << 30)))
+			break;
+		iter *= 2;
+	}
+
+	uint64_t ops = 0;
+	uint64_t allocs = allocCount.load();
+	uint64_t bytes = allocBytes.load();
+	int64_t start = nowNs();
+	int64_t elapsed;
+	do {
+		for (uint64_t i = 0; i < iter; i++)
+			fn();
+		ops += iter;
+		elapsed = nowNs() - start;
+	} while (elapsed < benchTime);
+	allocs = allocCount.load() - allocs;
+	bytes = allocBytes.load() - bytes;
+
+	printf("%-32s %12.1f ns/op %10.1f allocs/op %12.1f B/op\n", name,
+	       static_cast<double>(elapsed) / static_cast<double>(ops),
+	       static_cast<double>(allocs) / static_cast<double>(ops),
+	       static_cast<double>(bytes) / static_cast<double>(ops));
+	fflush(stdout);
+}
+
+static void fillVideoList(vector<listVideo_t>& lv, int rows)
+{
+	static const char* channels[] = { "ARD", "ZDF", "3Sat", "arte.DE", "BR", "NDR", "WDR", "SWR" };
+	string desc = "Die Dokumentation begleitet Menschen, die in einer kleinen Stadt an der Küste "
+		      "leben, durch ein ganzes Jahr. Zwischen Sturmflut und Sommergästen erzählen sie "
+		      "von Arbeit, Familie und der Frage, was bleibt, wenn die Jungen gehen. "
+		      "Mit Untertiteln für Hörgeschädigte. \"Bonus\": Interview & Making-of.";
+	lv.clear();
+	lv.reserve(rows);
+	for (int i = 0; i < rows; i++) {
+		listVideo_t v;
+		string n = to_string(i);
+		string base = "https://pdvideosdaserste-a.akamaihd.net/int/2024/05/" + n + "/video_" + n;
+		v.channel	= channels[i % 8];
+		v.theme		= "Thema " + to_string(i % 97);
+		v.title		= "Folge " + n + ": Ein Jahr am Meer";
+		v.description	= desc;
+		v.website	= "https://www.ardmediathek.de/video/" + n;
+		v.subtitle	= (i % 3 == 0) ? base + ".xml" : "";
+		v.url		= base + "_960x540.mp4";
+		v.url_small	= base + "_640x360.mp4";
+		v.url_hd	= base + "_1280x720.mp4";
+		v.date_unix	= 1700000000 + i * 600;
+		v.duration	= 1800 + (i % 60) * 30;
+		v.size_mb	= 300 + i % 700;
+		v.geo		= (i % 5 == 0) ? "DE-AT-CH" : "";
+		v.parse_m3u8	= 0;
+		lv.push_back(v);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	string filter = (argc > 1) ? argv[1] : "";
+
+	g_mainInstance = new CMtApi(false);
+	CNet* cnet = new CNet();
+	CJson* cjson = new CJson();
+
+	string query = "{\"software\":\"Neutrino Mediathek\",\"vMajor\":0,\"vMinor\":4,\"isBeta\":false,\"vBeta\":0,"
+		       "\"mode\":5,\"data\":{\"channel\":\"ARD\",\"timeMode\":1,\"epoch\":7,\"duration\":300,"
+		       "\"limit\":50,\"start\":0,\"refTime\":1700000000}}";
+	string post = "data1=" + cnet->encodeData(query) + "&session=4711&lang=de";
+	string encoded = cnet->encodeData(query);
+
+	bench(filter, "net/encodeData", [&]() { g_sink += cnet->encodeData(query).length(); });
+	bench(filter, "net/decodeData", [&]() { g_sink += cnet->decodeData(encoded).length(); });
+	string getQuery = "mode=api&sub=listVideos&stream=ndjson&session=4711&lang=de";
+	bench(filter, "formdata/parse", [&]() {
+		CFormData f;
+		f.parse(getQuery);
+		g_sink += f.size();
+	});
+	CFormData postData;
+	postData.parse(post);
+	bench(filter, "formdata/find", [&]() {
+		strView_t v;
+		g_sink += postData.find("data1", &v) ? v.len : 0;
+	});
+	bench(filter, "formdata/get", [&]() { g_sink += postData.get("data1").length(); });
+
+	bench(filter, "json/parseJsonFromString", [&]() {
+		Json::Value root;
+		string err;
+		g_sink += parseJsonFromString(query, &root, &err);
+	});
+	bench(filter, "json/parsePostQuery", [&]() {
+		cmdListVideo_t clv;
+		g_sink += cjson->parsePostQuery(query, &clv);
+	});
+
+	listVideoHead_t lvh;
+	lvh.start	= 0;
+	lvh.refTime	= 1700000000;
+	vector<listVideo_t> lv;
+	const int pages[] = { 50, 128, 256, 500, 5000 };
+	for (size_t i = 0; i < sizeof(pages) / sizeof(pages[0]); i++) {
+		fillVideoList(lv, pages[i]);
+		lvh.end		= pages[i] - 1;
+		lvh.rows	= pages[i];
+		lvh.total	= pages[i] * 10;
+		/* videoList2Json() consumes the rows, copyRows is the share of the copy */
+		string name = "json/copyRows/" + to_string(pages[i]);
+		bench(filter, name.c_str(), [&]() {
+			vector<listVideo_t> rows = lv;
+			g_sink += rows.size();
+		});
+		name = "json/videoList2Json/" + to_string(pages[i]);
+		bench(filter, name.c_str(), [&]() {
+			vector<listVideo_t> rows = lv;
+			g_sink += cjson->videoList2Json(&lvh, rows).length();
+		});
+	}
+
+	/* what a CGI process pays once before the pool serializes its first page */
+	bench(filter, "workpool/startStop", [&]() {
+		CWorkPool pool(2);
+		pool.parallelFor(3, [&](size_t c) { g_sink += c; });
+	});
+
+	/* the debug pages decode whole responses, mostly plain text */
+	vector<listVideo_t> responseRows(lv.begin(), lv.begin() + 50);
+	string response = cjson->videoList2Json(&lvh, responseRows);
+	bench(filter, "net/decodeData/response", [&]() { g_sink += cnet->decodeData(response).length(); });
+
+	Json::Value head = cjson->videoListHead2Json(&lvh);
+	bench(filter, "helpers/writeJson2String", [&]() { g_sink += writeJson2String(head).length(); });
+	bench(filter, "helpers/str_replace", [&]() {
+		string text = lv[0].description;
+		g_sink += str_replace("\"", "\\\"", text).length();
+	});
+	bench(filter, "helpers/base64encode", [&]() { g_sink += base64encode(lv[0].description).length(); });
+	bench(filter, "helpers/safeStrToInt", [&]() { g_sink += safeStrToInt("1700000000"); });
+
+	string sqlData = base64encode("SELECT * FROM video WHERE channel LIKE 'ARD' ORDER BY date_unix DESC LIMIT 0, 50");
+	string sqlId = "1";
+	bench(filter, "template/render", [&]() {
+		g_sink += g_mainInstance->templates()->render("sql-format.html", { { "SQL_DATA", sqlData }, { "ID", sqlId } }).length();
+	});
+
+	char dataFile[] = "/tmp/mt-api-bench-XXXXXX";
+	int fd = mkstemp(dataFile);
+	if (fd >= 0) {
+		string body = g_mainInstance->templates()->render("main-body.html");
+		g_sink += write(fd, body.data(), body.length());
+		close(fd);
+		bench(filter, "helpers/readFile", [&]() { g_sink += readFile(dataFile).length(); });
+		bench(filter, "filecache/get", [&]() {
+			CFileCache::view_t view;
+			g_sink += g_fileCache.get(dataFile, &view) ? view.size : 0;
+		});
+		unlink(dataFile);
+	}
+
+	/* cnet is left alone, its destructor would send an (empty) response */
+	delete cjson;
+	delete g_mainInstance;
+
+	return 0;
+}
@@ -0,0 +1,115 @@
+
+#include <sys/types.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "catalog.h"
+
+/*
+ * Offline catalog files outside the server (mt-api-catalog): builds a
+ * patch between two dumps with the server code, applies patches the way
+ * a client does and compares dumps. scripts/catalog-roundtrip.sh uses it
+ * to check that chained patches reproduce the current dump.
+ */
+
+static void usage(const char* prog)
+{
+	printf("Usage: %s patch OLD.mtc.gz NEW.mtc.gz PATCH.mtp.gz\n", prog);
+	printf("       %s apply DUMP.mtc.gz PATCH.mtp.gz... OUT.mtc.gz\n", prog);
+	printf("       %s compare DUMP1.mtc.gz DUMP2.mtc.gz\n", prog);
+	printf("\n");
+	printf("apply keeps the records in the order a client gets them: kept records\n");
+	printf("first, added ones appended. compare ignores the record order.\n");
+}
+
+static bool readDump(string file, vector<string>& records, int64_t* ver)
+{
+	CCatalogReader reader;
+	if (!reader.open(file) || !reader.beginDump(ver))
+		return false;
+
+	string record;
+	bool end = false;
+	while (reader.readRecord(record, &end) && !end)
+		records.push_back(record);
+
+	uint64_t count;
+	return (end && reader.readVarint(&count) && (count == records.size()));
+}
+
+static bool writeDump(string file, const vector<string>& records, int64_t ver)
+{
+	CCatalogWriter writer;
+	bool ok = writer.open(file) && writer.beginDump(ver);
+	for (size_t i = 0; ok && (i < records.size()); i++)
+		ok = writer.writeRecord(records[i]);
+	ok = ok && writer.endDump(records.size());
+	return writer.close() && ok;
+}
+
+static int runApply(int argc, char *argv[])
+{
+	vector<string> records;
+	int64_t ver;
+	if (!readDump(argv[0], records, &ver)) {
+		cerr << "Can't read " << argv[0] << endl;
+		return 1;
+	}
+	for (int i = 1; i < argc - 1; i++) {
+		if (!CCatalog::applyPatch(argv[i], records, &ver)) {
+			cerr << "Can't apply " << argv[i] << " to version " << ver << endl;
+			return 1;
+		}
+	}
+	if (!writeDump(argv[argc - 1], records, ver)) {
+		cerr << "Can't write " << argv[argc - 1] << endl;
+		return 1;
+	}
+	cerr << "version " << ver << ", " << records.size() << " records" << endl;
+	return 0;
+}
+
+static int runCompare(const char* file1, const char* file2)
+{
+	vector<string> records1, records2;
+	int64_t ver1, ver2;
+	if (!readDump(file1, records1, &ver1)) {
+		cerr << "Can't read " << file1 << endl;
+		return 1;
+	}
+	if (!readDump(file2, records2, &ver2)) {
+		cerr << "Can't read " << file2 << endl;
+		return 1;
+	}
+	sort(records1.begin(), records1.end());
+	sort(records2.begin(), records2.end());
+	if ((ver1 != ver2) || (records1 != records2)) {
+		cerr << "Different: version " << ver1 << " / " << ver2 << ", "
+		     << records1.size() << " / " << records2.size() << " records" << endl;
+		return 1;
+	}
+	cerr << "Equal: version " << ver1 << ", " << records1.size() << " records" << endl;
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	string cmd = (argc > 1) ? argv[1] : "";
+	if ((cmd == "patch") && (argc == 5)) {
+		if (!CCatalog::buildPatch(argv[2], argv[3], argv[4])) {
+			cerr << "Can't build " << argv[4] << endl;
+			return 1;
+		}
+		return 0;
+	}
+	if ((cmd == "apply") && (argc >= 5))
+		return runApply(argc - 2, argv + 2);
+	if ((cmd == "compare") && (argc == 4))
+		return runCompare(argv[2], argv[3]);
+
+	usage(argv[0]);
+	return ((cmd == "-h") || (cmd == "--help")) ? 0 : 1;
+}
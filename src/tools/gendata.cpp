@@ -0,0 +1,398 @@
+
+#include <sys/types.h>
+#include <getopt.h>
+#include <time.h>
+#include <math.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "catalog.h"
+#include "types.h"
+
+/*
+ * Synthetic video table for scaling tests (mt-api-gendata). Scale 1 is
+ * about the size of the MediathekView catalogue: 600000 rows over 60
+ * channels, channel and theme sizes follow a Zipf distribution, most
+ * videos are recent, descriptions are long German text and the urls of
+ * a video share their prefix. The output is deterministic for a seed
+ * and version; the dates are spread backwards from the version time.
+ *
+ * --skip, --date and --edit derive later versions of the same table for
+ * catalog patch tests: the oldest rows expire, new rows are added and a
+ * few rows change in place.
+ */
+
+static const int baseRows = 600000;
+
+static const char* channels[] = {
+	"ARD", "ZDF", "3Sat", "ARTE.DE", "BR", "NDR", "WDR", "SWR", "MDR", "HR",
+	"RBB", "SR", "Radio Bremen TV", "PHOENIX", "KiKA", "ZDFneo", "ZDFinfo", "ZDFtivi", "ONE", "ARD-alpha",
+	"tagesschau24", "DW", "ORF", "SRF", "SRF.Podcast", "Funk.net", "ARTE.FR", "ARTE.EN", "ARTE.ES", "ARTE.IT",
+	"ARTE.PL", "NDR Hamburg", "NDR Niedersachsen", "NDR Schleswig-Holstein", "NDR Mecklenburg-Vorpommern", "MDR Sachsen",
+	"MDR Sachsen-Anhalt", "MDR Thüringen", "SWR Baden-Württemberg", "SWR Rheinland-Pfalz", "WDR Aachen", "WDR Bielefeld",
+	"WDR Dortmund", "WDR Duisburg", "WDR Essen", "WDR Köln", "WDR Münster", "WDR Siegen", "WDR Wuppertal", "BR Franken",
+	"BR Schwaben", "BR Oberbayern", "HR Nordhessen", "RBB Brandenburg", "ORF III", "ORF Sport+", "SRF Info", "3Sat Kultur",
+	"Deutschlandfunk Nova", "ZDF Digital"
+};
+static const int channelCount = sizeof(channels) / sizeof(channels[0]);
+
+static const char* themeWords1[] = {
+	"Tatort", "Sportschau", "Tagesschau", "Kulturzeit", "Terra X", "Markt", "Panorama", "Weltspiegel",
+	"Planet Wissen", "Quarks", "Kontraste", "Lokalzeit", "Hallo Niedersachsen", "Die Sendung mit der Maus",
+	"Nachtcafé", "Querbeet", "Abendschau", "Brisant", "Länderspiegel", "Polizeiruf 110", "Wilsberg", "Dokumentation",
+	"Reportage", "Hörspiel", "Kinderfilm", "Spielfilm", "Serie", "Magazin", "Talk", "Musik"
+};
+static const char* themeWords2[] = {
+	"", " extra", " am Sonntag", " spezial", " kompakt", " regional", " international", " – Die Reihe",
+	" in Gebärdensprache", " mit Audiodeskription"
+};
+static const char* titleWords[] = {
+	"Ein Jahr am Meer", "Die letzte Fähre", "Zwischen den Welten", "Heimat auf Zeit", "Das große Backen",
+	"Wege aus der Krise", "Im Schatten der Berge", "Stadt, Land, Fluss", "Die Spur führt nach Norden",
+	"Was uns zusammenhält", "Leben am Limit", "Der stille Garten", "Nachtschicht", "Unter Verdacht",
+	"Wiedersehen in Wien", "Die Rückkehr", "Auf Messers Schneide", "Sommer im Park", "Grenzgänger", "Alte Liebe"
+};
+static const char* sentences[] = {
+	"Die Dokumentation begleitet Menschen, die in einer kleinen Stadt an der Küste leben, durch ein ganzes Jahr.",
+	"Zwischen Sturmflut und Sommergästen erzählen sie von Arbeit, Familie und der Frage, was bleibt.",
+	"Kommissarin Lindholm ermittelt in einem Fall, der sie tief in die eigene Vergangenheit führt.",
+	"Die Reporterin trifft Landwirte, die mit neuen Ideen auf Trockenheit und steigende Kosten reagieren.",
+	"Ein Blick hinter die Kulissen des Theaters, wo seit Monaten für die große Premiere geprobt wird.",
+	"Experten erklären, warum die Preise für Lebensmittel steigen und was Verbraucher dagegen tun können.",
+	"Das Magazin berichtet über aktuelle Themen aus Politik, Wirtschaft und Kultur der Region.",
+	"Mit Untertiteln für Hörgeschädigte und in der Mediathek sieben Tage lang verfügbar.",
+	"Im zweiten Teil der Reihe geht es um die Geschichte der Bahn und ihre Bedeutung für das Land.",
+	"Die Moderatorin spricht mit Gästen über Mut, Scheitern und den Neuanfang nach einer schweren Zeit.",
+	"Spektakuläre Aufnahmen zeigen die Tierwelt der Alpen im Wechsel der Jahreszeiten.",
+	"Nach dem Tod seines Vaters kehrt Jonas in das Dorf zurück, das er vor zwanzig Jahren verlassen hat.",
+	"Die Sendung fasst die wichtigsten Ereignisse des Tages zusammen und ordnet sie ein.",
+	"Hinweis: Aus rechtlichen Gründen ist dieses Video nur in Deutschland abrufbar.",
+	"Ein Film über Freundschaft, Verlust und die Kraft der Musik – ausgezeichnet mit dem Grimme-Preis."
+};
+#define COUNT(a) (sizeof(a) / sizeof(a[0]))
+
+/* splitmix64, the same sequence on every platform */
+class CRandom
+{
+	private:
+		uint64_t state;
+
+	public:
+		CRandom(uint64_t seed) { state = seed; };
+		uint64_t next()
+		{
+			uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+			return z ^ (z >> 31);
+		};
+		double uniform() { return static_cast<double>(next() >> 11) / 9007199254740992.0; };
+		int range(int n) { return static_cast<int>(uniform() * n); };
+};
+
+/* cumulative Zipf weights, pick() draws an index */
+class CZipf
+{
+	private:
+		vector<double> cdf;
+
+	public:
+		CZipf(int n, double s)
+		{
+			double sum = 0;
+			for (int i = 1; i <= n; i++) {
+				sum += 1.0 / pow(i, s);
+				cdf.push_back(sum);
+			}
+			for (size_t i = 0; i < cdf.size(); i++)
+				cdf[i] /= sum;
+		};
+		int pick(CRandom& rnd)
+		{
+			double u = rnd.uniform();
+			size_t lo = 0, hi = cdf.size() - 1;
+			while (lo < hi) {
+				size_t mid = (lo + hi) / 2;
+				if (cdf[mid] < u)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			return static_cast<int>(lo);
+		};
+};
+
+struct channelStat_t {
+	int count;
+	time_t latest;
+	time_t oldest;
+};
+
+static string sqlQuote(const string& in)
+{
+	string out = "'";
+	for (size_t i = 0; i < in.length(); i++) {
+		if (in[i] == '\'')
+			out += "''";
+		else if (in[i] == '\\')
+			out += "\\\\";
+		else
+			out += in[i];
+	}
+	return out + "'";
+}
+
+static string urlPart(const string& in)
+{
+	string out;
+	for (size_t i = 0; i < in.length(); i++) {
+		unsigned char c = static_cast<unsigned char>(in[i]);
+		if (isalnum(c))
+			out += static_cast<char>(tolower(c));
+		else if (!out.empty() && (out[out.length() - 1] != '-'))
+			out += '-';
+	}
+	return out;
+}
+
+static void makeVideo(CRandom& rnd, CZipf& channelZipf, vector<CZipf>& themeZipf, time_t now, int id, listVideo_t* lv)
+{
+	int ch = channelZipf.pick(rnd);
+	int theme = themeZipf[ch].pick(rnd);
+	lv->channel	= channels[ch];
+	lv->theme	= string(themeWords1[theme % COUNT(themeWords1)]) + themeWords2[(theme / COUNT(themeWords1)) % COUNT(themeWords2)];
+	lv->title	= string(titleWords[rnd.range(COUNT(titleWords))]);
+	if (rnd.range(3) > 0)
+		lv->title = "Folge " + to_string(1 + rnd.range(400)) + ": " + lv->title;
+
+	/* 1-12 sentences, mostly short */
+	int n = 1 + static_cast<int>(12 * pow(rnd.uniform(), 2.0));
+	lv->description.clear();
+	for (int i = 0; i < n; i++) {
+		if (i > 0)
+			lv->description += " ";
+		lv->description += sentences[rnd.range(COUNT(sentences))];
+	}
+
+	/* age: exponential, mean 60 days, at most 3 years */
+	double age = -log(1.0 - rnd.uniform()) * 60.0 * 86400.0;
+	if (age > 3 * 365 * 86400.0)
+		age = rnd.uniform() * 3 * 365 * 86400.0;
+	lv->date_unix	= now - static_cast<time_t>(age);
+	lv->duration	= 60 + static_cast<int>(exp(rnd.uniform() * 5.0) * 60.0) % 10800;
+	lv->size_mb	= lv->duration * (3 + rnd.range(4)) / 60;
+
+	struct tm tmDate;
+	gmtime_r(&lv->date_unix, &tmDate);
+	char date[16];
+	strftime(date, sizeof(date), "%Y/%m/%d", &tmDate);
+	string base = "https://media.example-" + urlPart(lv->channel) + ".de/mp4/" + date + "/" + to_string(id) + "/" + urlPart(lv->theme);
+	lv->url		= base + "_960x540.mp4";
+	lv->url_small	= base + "_640x360.mp4";
+	lv->url_hd	= (rnd.range(10) < 7) ? base + "_1920x1080.mp4" : "";
+	lv->subtitle	= (rnd.range(10) < 4) ? "https://media.example-" + urlPart(lv->channel) + ".de/ut/" + to_string(id) + ".xml" : "";
+	lv->website	= "https://www.example-" + urlPart(lv->channel) + ".de/video/" + to_string(id);
+	lv->url_rtmp.clear();
+	lv->url_rtmp_small.clear();
+	lv->url_rtmp_hd.clear();
+	lv->url_history.clear();
+	int geo = rnd.range(20);
+	lv->geo		= (geo < 2) ? "DE" : ((geo < 4) ? "DE-AT-CH" : "");
+	lv->parse_m3u8	= (rnd.range(50) == 0) ? 1 : 0;
+}
+
+static void usage(const char* prog)
+{
+	printf("Usage: %s [options]\n", prog);
+	printf("  --scale F      catalogue size, 1 = %d rows (default 1)\n", baseRows);
+	printf("  --rows N       number of rows, overrides --scale\n");
+	printf("  --sql FILE     write SQL (CREATE TABLE and INSERTs), - for stdout\n");
+	printf("  --catalog FILE write an offline catalog dump (catalog-<version>.mtc.gz)\n");
+	printf("  --version N    catalog version / movie list date (default: now)\n");
+	printf("  --date N       time the dates are spread back from (default: --version)\n");
+	printf("  --skip N       leave out the first N of the rows\n");
+	printf("  --edit N       change the title of every Nth row, depends on --version\n");
+	printf("  --seed N       random seed (default 1)\n");
+	printf("  --batch N      rows per INSERT statement (default 1000)\n");
+	printf("  --no-create    no CREATE TABLE statements\n");
+	printf("  -h, --help     this help\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option longOpts[] = {
+		{ "scale",	required_argument,	NULL, 's' },
+		{ "rows",	required_argument,	NULL, 'r' },
+		{ "sql",	required_argument,	NULL, 'q' },
+		{ "catalog",	required_argument,	NULL, 'c' },
+		{ "version",	required_argument,	NULL, 'v' },
+		{ "date",	required_argument,	NULL, 'd' },
+		{ "skip",	required_argument,	NULL, 'k' },
+		{ "edit",	required_argument,	NULL, 'e' },
+		{ "seed",	required_argument,	NULL, 'S' },
+		{ "batch",	required_argument,	NULL, 'b' },
+		{ "no-create",	no_argument,		NULL, 'n' },
+		{ "help",	no_argument,		NULL, 'h' },
+		{ NULL,		0,			NULL, 0 }
+	};
+
+	double scale = 1.0;
+	long long rows = -1;
+	string sqlFile, catalogFile;
+	int64_t catalogVersion = time(NULL);
+	int64_t date = -1;
+	long long skip = 0;
+	int64_t edit = 0;
+	uint64_t seed = 1;
+	int batch = 1000;
+	bool create = true;
+	int opt;
+	while ((opt = getopt_long(argc, argv, "h", longOpts, NULL)) != -1) {
+		switch (opt) {
+			case 's':	scale = atof(optarg); break;
+			case 'r':	rows = atoll(optarg); break;
+			case 'q':	sqlFile = optarg; break;
+			case 'c':	catalogFile = optarg; break;
+			case 'v':	catalogVersion = atoll(optarg); break;
+			case 'd':	date = atoll(optarg); break;
+			case 'k':	skip = max(0LL, atoll(optarg)); break;
+			case 'e':	edit = max(0LL, atoll(optarg)); break;
+			case 'S':	seed = strtoull(optarg, NULL, 10); break;
+			case 'b':	batch = max(1, atoi(optarg)); break;
+			case 'n':	create = false; break;
+			case 'h':	usage(argv[0]); return 0;
+			default:	usage(argv[0]); return 1;
+		}
+	}
+	if (rows < 0)
+		rows = static_cast<long long>(baseRows * scale);
+	skip = min(skip, rows);
+	if (date < 0)
+		date = catalogVersion;
+	if ((sqlFile.empty() && catalogFile.empty()) || (optind != argc)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	FILE* sql = NULL;
+	if (!sqlFile.empty()) {
+		sql = (sqlFile == "-") ? stdout : fopen(sqlFile.c_str(), "w");
+		if (sql == NULL) {
+			cerr << "Can't write " << sqlFile << endl;
+			return 1;
+		}
+	}
+	CCatalogWriter catalog;
+	if (!catalogFile.empty() && (!catalog.open(catalogFile) || !catalog.beginDump(catalogVersion))) {
+		cerr << "Can't write " << catalogFile << endl;
+		return 1;
+	}
+
+	if ((sql != NULL) && create) {
+		fprintf(sql,
+			"CREATE TABLE IF NOT EXISTS video (\n"
+			"  id int(11) NOT NULL AUTO_INCREMENT,\n"
+			"  channel varchar(256) NOT NULL DEFAULT '',\n"
+			"  theme varchar(1024) NOT NULL DEFAULT '',\n"
+			"  title varchar(1024) NOT NULL DEFAULT '',\n"
+			"  description text NOT NULL,\n"
+			"  website varchar(1024) NOT NULL DEFAULT '',\n"
+			"  subtitle varchar(1024) NOT NULL DEFAULT '',\n"
+			"  url varchar(1024) NOT NULL DEFAULT '',\n"
+			"  url_small varchar(1024) NOT NULL DEFAULT '',\n"
+			"  url_hd varchar(1024) NOT NULL DEFAULT '',\n"
+			"  url_rtmp varchar(1024) NOT NULL DEFAULT '',\n"
+			"  url_rtmp_small varchar(1024) NOT NULL DEFAULT '',\n"
+			"  url_rtmp_hd varchar(1024) NOT NULL DEFAULT '',\n"
+			"  url_history varchar(1024) NOT NULL DEFAULT '',\n"
+			"  date_unix int(11) NOT NULL DEFAULT 0,\n"
+			"  duration int(11) NOT NULL DEFAULT 0,\n"
+			"  size_mb int(11) NOT NULL DEFAULT 0,\n"
+			"  geo varchar(256) NOT NULL DEFAULT '',\n"
+			"  parse_m3u8 int(11) NOT NULL DEFAULT 0,\n"
+			"  PRIMARY KEY (id),\n"
+			"  KEY channel (channel),\n"
+			"  KEY date_unix (date_unix)\n"
+			") DEFAULT CHARSET=utf8mb4;\n"
+			"CREATE TABLE IF NOT EXISTS version (\n"
+			"  version varchar(256) NOT NULL DEFAULT '',\n"
+			"  vdate int(11) NOT NULL DEFAULT 0,\n"
+			"  mvversion varchar(256) NOT NULL DEFAULT '',\n"
+			"  mvdate int(11) NOT NULL DEFAULT 0,\n"
+			"  mventrys int(11) NOT NULL DEFAULT 0,\n"
+			"  progname varchar(256) NOT NULL DEFAULT '',\n"
+			"  progversion varchar(256) NOT NULL DEFAULT ''\n"
+			") DEFAULT CHARSET=utf8mb4;\n"
+			"CREATE TABLE IF NOT EXISTS channelinfo (\n"
+			"  channel varchar(256) NOT NULL DEFAULT '',\n"
+			"  count int(11) NOT NULL DEFAULT 0,\n"
+			"  latest int(11) NOT NULL DEFAULT 0,\n"
+			"  oldest int(11) NOT NULL DEFAULT 0\n"
+			") DEFAULT CHARSET=utf8mb4;\n");
+	}
+
+	time_t now = static_cast<time_t>(date);
+	CRandom rnd(seed);
+	CZipf channelZipf(channelCount, 1.1);
+	vector<CZipf> themeZipf;
+	for (int i = 0; i < channelCount; i++)
+		themeZipf.push_back(CZipf(COUNT(themeWords1) * COUNT(themeWords2), 1.0));
+	map<string, channelStat_t> stats;
+
+	listVideo_t lv;
+	bool ok = true;
+	for (long long i = 0; ok && (i < rows); i++) {
+		makeVideo(rnd, channelZipf, themeZipf, now, static_cast<int>(i + 1), &lv);
+		if (i < skip)
+			continue;
+		if ((edit > 0) && ((i + catalogVersion) % edit == 0))
+			lv.title += " (" + to_string(catalogVersion) + ")";
+		long long n = i - skip;
+
+		channelStat_t& st = stats[lv.channel];
+		if (st.count++ == 0)
+			st.latest = st.oldest = lv.date_unix;
+		st.latest = max(st.latest, lv.date_unix);
+		st.oldest = min(st.oldest, lv.date_unix);
+
+		if (sql != NULL) {
+			if (n % batch == 0)
+				fprintf(sql, "INSERT INTO video (channel, theme, title, description, website, subtitle, url, url_small, url_hd, "
+					     "url_rtmp, url_rtmp_small, url_rtmp_hd, url_history, date_unix, duration, size_mb, geo, parse_m3u8) VALUES\n");
+			fprintf(sql, "(%s,%s,%s,%s,%s,%s,%s,%s,%s,'','','','',%lld,%d,%d,%s,%d)%s\n",
+				sqlQuote(lv.channel).c_str(), sqlQuote(lv.theme).c_str(), sqlQuote(lv.title).c_str(),
+				sqlQuote(lv.description).c_str(), sqlQuote(lv.website).c_str(), sqlQuote(lv.subtitle).c_str(),
+				sqlQuote(lv.url).c_str(), sqlQuote(lv.url_small).c_str(), sqlQuote(lv.url_hd).c_str(),
+				static_cast<long long>(lv.date_unix), lv.duration, lv.size_mb, sqlQuote(lv.geo).c_str(), lv.parse_m3u8,
+				((n % batch == batch - 1) || (i == rows - 1)) ? ";" : ",");
+		}
+		if (!catalogFile.empty())
+			ok = catalog.writeRecord(CCatalog::encodeRecord(&lv));
+	}
+
+	if (sql != NULL) {
+		fprintf(sql, "INSERT INTO version (version, vdate, mvversion, mvdate, mventrys, progname, progversion) "
+			     "VALUES ('synthetic', %lld, 'synthetic', %lld, %lld, 'mt-api-gendata', '1');\n",
+			static_cast<long long>(now), static_cast<long long>(catalogVersion), rows - skip);
+		for (map<string, channelStat_t>::iterator it = stats.begin(); it != stats.end(); ++it)
+			fprintf(sql, "INSERT INTO channelinfo (channel, count, latest, oldest) VALUES (%s, %d, %lld, %lld);\n",
+				sqlQuote(it->first).c_str(), it->second.count,
+				static_cast<long long>(it->second.latest), static_cast<long long>(it->second.oldest));
+		ok = (fflush(sql) == 0) && ok;
+		if (sql != stdout)
+			ok = (fclose(sql) == 0) && ok;
+	}
+	if (!catalogFile.empty())
+		ok = catalog.endDump(rows - skip) && catalog.close() && ok;
+
+	if (!ok) {
+		cerr << "Write error" << endl;
+		return 1;
+	}
+	cerr << (rows - skip) << " rows, " << stats.size() << " channels" << endl;
+
+	return 0;
+}
@@ -0,0 +1,96 @@
+#include <sys/types.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "template.h"
+
+/*
+ * Build step (mt-api-gentpl): writes the templates given on the command
+ * line as C++ source with their text and precomputed segments, the
+ * table g_templates[] of template.h. Templates are named by file name.
+ */
+
+static string cString(const string& data)
+{
+	string ret = "\t\"";
+	char oct[8];
+	for (size_t i = 0; i < data.length(); i++) {
+		unsigned char c = data[i];
+		if (c == '\n') {
+			ret += "\\n";
+			if (i + 1 < data.length())
+				ret += "\"\n\t\"";
+		}
+		else if ((c == '"') || (c == '\\') || (c == '?')) {
+			ret += '\\';
+			ret += c;
+		}
+		else if ((c < 0x20) || (c >= 0x7f)) {
+			snprintf(oct, sizeof(oct), "\\%03o", c);
+			ret += oct;
+		}
+		else
+			ret += c;
+	}
+	return ret + "\"";
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		cerr << "Usage: " << argv[0] << " <template>... > templates-data.cpp" << endl;
+		return 1;
+	}
+
+	stringstream out, table;
+	out << "/* generated by mt-api-gentpl, do not edit */" << endl << endl;
+	out << "#include \"template.h\"" << endl;
+
+	for (int i = 1; i < argc; i++) {
+		ifstream in(argv[i], ifstream::binary);
+		if (!in.is_open()) {
+			cerr << "Error read " << argv[i] << endl;
+			return 1;
+		}
+		stringstream data;
+		data << in.rdbuf();
+		string text = data.str();
+
+		vector<CTemplate::segment_t> segments;
+		if (!CTemplate::parse(text.data(), text.length(), segments)) {
+			cerr << "Template too large: " << argv[i] << endl;
+			return 1;
+		}
+
+		string name = argv[i];
+		size_t slash = name.find_last_of('/');
+		if (slash != string::npos)
+			name = name.substr(slash + 1);
+
+		out << endl << "/* " << name << " */" << endl;
+		out << "static const char tplText" << i << "[] =" << endl << cString(text) << ";" << endl;
+		out << "static const CTemplate::segment_t tplSegments" << i << "[] = {" << endl;
+		for (size_t j = 0; j < segments.size(); j++) {
+			out << "\t{ " << segments[j].pos << ", " << segments[j].len << ", " << ((segments[j].var) ? "true" : "false") << " },";
+			if (segments[j].var)
+				out << " /* " << text.substr(segments[j].pos, segments[j].len) << " */";
+			out << endl;
+		}
+		/* no empty arrays */
+		if (segments.empty())
+			out << "\t{ 0, 0, false }" << endl;
+		out << "};" << endl;
+
+		table << "\t{ \"" << name << "\", tplText" << i << ", " << text.length() << ", tplSegments" << i << ", " << segments.size() << " }," << endl;
+	}
+
+	out << endl << "const CTemplate::compiled_t g_templates[] = {" << endl << table.str() << "};" << endl;
+	out << "const size_t g_templateCount = sizeof(g_templates) / sizeof(g_templates[0]);" << endl;
+	cout << out.str();
+
+	return 0;
+}
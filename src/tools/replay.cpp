@@ -0,0 +1,695 @@
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <thread>
+
+#include "replay.h"
+
+extern char** environ;
+
+/* FastCGI record types and role, see the FastCGI specification */
+#define FCGI_VERSION_1		1
+#define FCGI_BEGIN_REQUEST	1
+#define FCGI_END_REQUEST	3
+#define FCGI_PARAMS		4
+#define FCGI_STDIN		5
+#define FCGI_STDOUT		6
+#define FCGI_RESPONDER		1
+
+CReplay::CReplay()
+{
+	skipped		= 0;
+	targetType	= targetCgi;
+	scriptPath	= "/mt-api";
+	serverName	= "localhost";
+	concurrency	= 1;
+	rate		= 0;
+	total		= 0;
+	timeoutMs	= 30000;
+	next		= 0;
+	startTime	= 0;
+}
+
+int64_t CReplay::now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+/* "[ts] event=name pid=N key=value key=\"quoted \\\"value\\\"\"" */
+bool CReplay::parseLine(const string& line, string& event, int& pid, map<string, string>& fields)
+{
+	size_t pos = line.find("] ");
+	if ((line.empty()) || (line[0] != '[') || (pos == string::npos))
+		return false;
+	pos += 2;
+
+	fields.clear();
+	while (pos < line.length()) {
+		size_t eq = line.find('=', pos);
+		if (eq == string::npos)
+			break;
+		string key = line.substr(pos, eq - pos);
+		string val;
+		pos = eq + 1;
+		if ((pos < line.length()) && (line[pos] == '"')) {
+			for (pos++; (pos < line.length()) && (line[pos] != '"'); pos++) {
+				char c = line[pos];
+				if ((c == '\\') && (pos + 1 < line.length())) {
+					c = line[++pos];
+					if (c == 'n')
+						c = '\n';
+					else if (c == 'r')
+						c = '\r';
+					else if (c == 't')
+						c = '\t';
+				}
+				val += c;
+			}
+			pos++;
+		}
+		else {
+			size_t end = line.find(' ', pos);
+			if (end == string::npos)
+				end = line.length();
+			val = line.substr(pos, end - pos);
+			pos = end;
+		}
+		while ((pos < line.length()) && (line[pos] == ' '))
+			pos++;
+		fields[key] = val;
+	}
+
+	event = fields["event"];
+	pid = atoi(fields["pid"].c_str());
+
+	return !event.empty();
+}
+
+string CReplay::urlEncode(const string& in)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	string out;
+	out.reserve(in.length() * 3);
+	for (size_t i = 0; i < in.length(); i++) {
+		unsigned char c = static_cast<unsigned char>(in[i]);
+		if (isalnum(c) || (c == '-') || (c == '_') || (c == '.') || (c == '~')) {
+			out += static_cast<char>(c);
+		}
+		else {
+			out += '%';
+			out += hex[c >> 4];
+			out += hex[c & 0x0f];
+		}
+	}
+	return out;
+}
+
+bool CReplay::loadLog(string file)
+{
+	struct pending_t {
+		request_t r;
+		bool truncated;
+	};
+
+	ifstream in(file.c_str());
+	if (!in.good()) {
+		cerr << "Can't open " << file << endl;
+		return false;
+	}
+
+	/* the events of one request share the pid and end with request-timing */
+	map<int, pending_t> pending;
+	string line, event;
+	int pid;
+	map<string, string> fields;
+	while (getline(in, line)) {
+		if (!parseLine(line, event, pid, fields))
+			continue;
+
+		map<int, pending_t>::iterator it = pending.find(pid);
+		if ((event == "request-start") || (event == "request-timing")) {
+			if (it != pending.end()) {
+				if (it->second.truncated)
+					skipped++;
+				else
+					requests.push_back(it->second.r);
+				pending.erase(it);
+			}
+			if (event == "request-start") {
+				pending_t p;
+				p.r.method	= (fields["method"].empty()) ? "GET" : fields["method"];
+				p.r.query	= fields["query"];
+				p.truncated	= false;
+				pending[pid]	= p;
+			}
+		}
+		else if ((event == "request-payload") && (it != pending.end())) {
+			string data = fields["data1"];
+			const string cut = "...(truncated)";
+			if ((data.length() >= cut.length()) && (data.compare(data.length() - cut.length(), cut.length(), cut) == 0))
+				it->second.truncated = true;
+			/* older logs replaced the quotes of the payload */
+			if ((data.find('"') == string::npos) && (data.find('\'') != string::npos))
+				replace(data.begin(), data.end(), '\'', '"');
+			if (it->second.r.method == "POST")
+				it->second.r.body = "data1=" + urlEncode(data);
+		}
+	}
+	for (map<int, pending_t>::iterator it = pending.begin(); it != pending.end(); ++it) {
+		if (it->second.truncated)
+			skipped++;
+		else
+			requests.push_back(it->second.r);
+	}
+
+	return !requests.empty();
+}
+
+void CReplay::addRequest(string method, string query, string body)
+{
+	request_t r;
+	r.method	= method;
+	r.query		= query;
+	r.body		= body;
+	requests.push_back(r);
+}
+
+vector<pair<string, string> > CReplay::cgiParams(const request_t& r)
+{
+	vector<pair<string, string> > p;
+	string uri = scriptPath + ((r.query.empty()) ? "" : "?" + r.query);
+	const char* docRoot = getenv("DOCUMENT_ROOT");
+
+	p.push_back(make_pair("GATEWAY_INTERFACE", "CGI/1.1"));
+	p.push_back(make_pair("SERVER_PROTOCOL", "HTTP/1.1"));
+	p.push_back(make_pair("SERVER_NAME", serverName));
+	p.push_back(make_pair("HTTP_HOST", serverName));
+	p.push_back(make_pair("REMOTE_ADDR", "127.0.0.1"));
+	p.push_back(make_pair("REQUEST_METHOD", r.method));
+	p.push_back(make_pair("QUERY_STRING", r.query));
+	p.push_back(make_pair("REQUEST_URI", uri));
+	p.push_back(make_pair("SCRIPT_NAME", scriptPath));
+	if (docRoot != NULL) {
+		p.push_back(make_pair("DOCUMENT_ROOT", string(docRoot)));
+		p.push_back(make_pair("SCRIPT_FILENAME", string(docRoot) + scriptPath));
+	}
+	if (!r.body.empty()) {
+		p.push_back(make_pair("CONTENT_TYPE", "application/x-www-form-urlencoded"));
+		p.push_back(make_pair("CONTENT_LENGTH", to_string(r.body.length())));
+	}
+
+	return p;
+}
+
+/* "Status: 404 ..." (CGI, default 200) or "HTTP/1.1 404 ..." */
+int CReplay::parseStatus(const string& head, bool http)
+{
+	if (http) {
+		size_t pos = head.find(' ');
+		if ((head.compare(0, 5, "HTTP/") != 0) || (pos == string::npos))
+			return 0;
+		return atoi(head.c_str() + pos + 1);
+	}
+
+	size_t end = head.find("\r\n\r\n");
+	if (end == string::npos)
+		end = head.find("\n\n");
+	if (end == string::npos)
+		return 0;
+	string h = "\n" + head.substr(0, end);
+	size_t pos = h.find("\nStatus:");
+	if (pos == string::npos)
+		return 200;
+	return atoi(h.c_str() + pos + 8);
+}
+
+/* firstByte: time of the first response byte, if not set yet */
+bool CReplay::readAll(int fd, string& out, int64_t* firstByte)
+{
+	char buf[16384];
+	for (;;) {
+		ssize_t n = read(fd, buf, sizeof(buf));
+		if ((n > 0) && (*firstByte == 0))
+			*firstByte = now();
+		if (n > 0)
+			out.append(buf, n);
+		else if (n == 0)
+			return true;
+		else if (errno != EINTR)
+			return false;
+	}
+}
+
+static bool writeAll(int fd, const char* data, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = write(fd, data, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		data += n;
+		len -= n;
+	}
+	return true;
+}
+
+static bool readFull(int fd, char* data, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = read(fd, data, len);
+		if (n <= 0) {
+			if ((n < 0) && (errno == EINTR))
+				continue;
+			return false;
+		}
+		data += n;
+		len -= n;
+	}
+	return true;
+}
+
+/* "unix:/path", "/path" or "host:port" */
+int CReplay::connectTarget()
+{
+	int fd = -1;
+	if ((target.compare(0, 5, "unix:") == 0) || ((!target.empty()) && (target[0] == '/'))) {
+		string path = (target[0] == '/') ? target : target.substr(5);
+		struct sockaddr_un sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sun_family = AF_UNIX;
+		if (path.length() >= sizeof(sa.sun_path))
+			return -1;
+		strcpy(sa.sun_path, path.c_str());
+		fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if ((fd >= 0) && (connect(fd, reinterpret_cast<struct sockaddr*>(&sa), sizeof(sa)) != 0)) {
+			close(fd);
+			fd = -1;
+		}
+	}
+	else {
+		size_t pos = target.rfind(':');
+		if (pos == string::npos)
+			return -1;
+		string host = target.substr(0, pos);
+		string port = target.substr(pos + 1);
+		if ((host.length() > 1) && (host[0] == '[') && (host[host.length() - 1] == ']'))
+			host = host.substr(1, host.length() - 2);
+
+		struct addrinfo hints, *res;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0)
+			return -1;
+		for (struct addrinfo* ai = res; ai != NULL; ai = ai->ai_next) {
+			fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+			if (fd < 0)
+				continue;
+			if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+				break;
+			close(fd);
+			fd = -1;
+		}
+		freeaddrinfo(res);
+	}
+
+	if (fd >= 0) {
+		struct timeval tv;
+		tv.tv_sec = timeoutMs / 1000;
+		tv.tv_usec = (timeoutMs % 1000) * 1000;
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+	}
+
+	return fd;
+}
+
+bool CReplay::runCgi(const request_t& r, int& status, size_t& bytes, int64_t* firstByte)
+{
+	/* environment of this process, request variables replaced */
+	vector<pair<string, string> > params = cgiParams(r);
+	vector<string> envStr;
+	for (char** e = environ; *e != NULL; e++) {
+		string var = *e;
+		string name = var.substr(0, var.find('='));
+		bool replaced = false;
+		for (size_t i = 0; i < params.size(); i++) {
+			if (params[i].first == name)
+				replaced = true;
+		}
+		if (!replaced && (name != "CONTENT_LENGTH") && (name != "CONTENT_TYPE"))
+			envStr.push_back(var);
+	}
+	for (size_t i = 0; i < params.size(); i++)
+		envStr.push_back(params[i].first + "=" + params[i].second);
+	vector<char*> env;
+	for (size_t i = 0; i < envStr.size(); i++)
+		env.push_back(const_cast<char*>(envStr[i].c_str()));
+	env.push_back(NULL);
+	char* argv[] = { const_cast<char*>(target.c_str()), NULL };
+
+	int pin[2], pout[2];
+	if (pipe2(pin, O_CLOEXEC) != 0)
+		return false;
+	if (pipe2(pout, O_CLOEXEC) != 0) {
+		close(pin[0]);
+		close(pin[1]);
+		return false;
+	}
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		dup2(pin[0], STDIN_FILENO);
+		dup2(pout[1], STDOUT_FILENO);
+		execve(argv[0], argv, env.data());
+		_exit(127);
+	}
+	close(pin[0]);
+	close(pout[1]);
+	if (pid < 0) {
+		close(pin[1]);
+		close(pout[0]);
+		return false;
+	}
+
+	writeAll(pin[1], r.body.data(), r.body.length());
+	close(pin[1]);
+	string out;
+	bool ok = readAll(pout[0], out, firstByte);
+	close(pout[0]);
+	int wstatus = 0;
+	while ((waitpid(pid, &wstatus, 0) < 0) && (errno == EINTR))
+		;
+
+	bytes = out.length();
+	status = parseStatus(out, false);
+	return (ok && WIFEXITED(wstatus) && (WEXITSTATUS(wstatus) == 0));
+}
+
+static void fcgiRecord(string& out, int type, const char* data, size_t len)
+{
+	unsigned char h[8] = { FCGI_VERSION_1, static_cast<unsigned char>(type), 0, 1,
+			       static_cast<unsigned char>(len >> 8), static_cast<unsigned char>(len & 0xff), 0, 0 };
+	out.append(reinterpret_cast<char*>(h), sizeof(h));
+	out.append(data, len);
+}
+
+static void fcgiLength(string& out, size_t len)
+{
+	if (len < 128) {
+		out += static_cast<char>(len);
+	}
+	else {
+		out += static_cast<char>(((len >> 24) & 0x7f) | 0x80);
+		out += static_cast<char>((len >> 16) & 0xff);
+		out += static_cast<char>((len >> 8) & 0xff);
+		out += static_cast<char>(len & 0xff);
+	}
+}
+
+bool CReplay::runFcgi(const request_t& r, int& status, size_t& bytes, int64_t* firstByte)
+{
+	int fd = connectTarget();
+	if (fd < 0)
+		return false;
+
+	string req;
+	const char begin[8] = { 0, FCGI_RESPONDER, 0, 0, 0, 0, 0, 0 };
+	fcgiRecord(req, FCGI_BEGIN_REQUEST, begin, sizeof(begin));
+
+	vector<pair<string, string> > params = cgiParams(r);
+	string p;
+	for (size_t i = 0; i < params.size(); i++) {
+		fcgiLength(p, params[i].first.length());
+		fcgiLength(p, params[i].second.length());
+		p += params[i].first + params[i].second;
+	}
+	for (size_t pos = 0; pos < p.length(); pos += 65535)
+		fcgiRecord(req, FCGI_PARAMS, p.data() + pos, min(p.length() - pos, static_cast<size_t>(65535)));
+	fcgiRecord(req, FCGI_PARAMS, "", 0);
+	for (size_t pos = 0; pos < r.body.length(); pos += 65535)
+		fcgiRecord(req, FCGI_STDIN, r.body.data() + pos, min(r.body.length() - pos, static_cast<size_t>(65535)));
+	fcgiRecord(req, FCGI_STDIN, "", 0);
+
+	bool ok = writeAll(fd, req.data(), req.length());
+	bool ended = false;
+	string out;
+	char buf[65535 + 255];
+	while (ok && !ended) {
+		unsigned char h[8];
+		if (!readFull(fd, reinterpret_cast<char*>(h), sizeof(h))) {
+			ok = false;
+			break;
+		}
+		size_t len = (h[4] << 8) | h[5];
+		if (!readFull(fd, buf, len + h[6])) {
+			ok = false;
+			break;
+		}
+		if ((h[1] == FCGI_STDOUT) && (len > 0) && (*firstByte == 0))
+			*firstByte = now();
+		if (h[1] == FCGI_STDOUT)
+			out.append(buf, len);
+		else if (h[1] == FCGI_END_REQUEST)
+			ended = true;
+	}
+	close(fd);
+
+	bytes = out.length();
+	status = parseStatus(out, false);
+	return (ok && ended);
+}
+
+bool CReplay::runHttp(const request_t& r, int& status, size_t& bytes, int64_t* firstByte)
+{
+	int fd = connectTarget();
+	if (fd < 0)
+		return false;
+
+	string req = r.method + " " + scriptPath + ((r.query.empty()) ? "" : "?" + r.query) + " HTTP/1.1\r\n";
+	req += "Host: " + serverName + "\r\n";
+	req += "Connection: close\r\n";
+	if (!r.body.empty()) {
+		req += "Content-Type: application/x-www-form-urlencoded\r\n";
+		req += "Content-Length: " + to_string(r.body.length()) + "\r\n";
+	}
+	req += "\r\n" + r.body;
+
+	string out;
+	bool ok = (writeAll(fd, req.data(), req.length()) && readAll(fd, out, firstByte));
+	close(fd);
+
+	bytes = out.length();
+	status = parseStatus(out, true);
+	return ok;
+}
+
+void CReplay::worker()
+{
+	vector<result_t> local;
+	map<int, uint64_t> localStatus;
+	for (;;) {
+		uint64_t i = next.fetch_add(1);
+		if (i >= total)
+			break;
+		const request_t& r = requests[i % requests.size()];
+
+		/*
+		 * With a fixed rate the latency is counted from the planned start,
+		 * so a stalled target does not hide the requests queued behind it.
+		 */
+		int64_t begin;
+		if (rate > 0) {
+			begin = startTime + static_cast<int64_t>(static_cast<double>(i) * 1e9 / rate);
+			int64_t wait = begin - now();
+			if (wait > 0) {
+				struct timespec ts;
+				ts.tv_sec = wait / 1000000000LL;
+				ts.tv_nsec = wait % 1000000000LL;
+				while ((nanosleep(&ts, &ts) != 0) && (errno == EINTR))
+					;
+			}
+		}
+		else {
+			begin = now();
+		}
+
+		result_t res;
+		res.status = 0;
+		res.bytes = 0;
+		int64_t firstByte = 0;
+		bool ok;
+		if (targetType == targetFcgi)
+			ok = runFcgi(r, res.status, res.bytes, &firstByte);
+		else if (targetType == targetHttp)
+			ok = runHttp(r, res.status, res.bytes, &firstByte);
+		else
+			ok = runCgi(r, res.status, res.bytes, &firstByte);
+		int64_t end = now();
+		res.latency = end - begin;
+		res.firstByte = ((firstByte != 0) ? firstByte : end) - begin;
+		if (!ok)
+			res.status = 0;
+		local.push_back(res);
+		localStatus[res.status]++;
+	}
+
+	lock_guard<mutex> lock(resultLock);
+	results.insert(results.end(), local.begin(), local.end());
+	for (map<int, uint64_t>::iterator it = localStatus.begin(); it != localStatus.end(); ++it)
+		statusCount[it->first] += it->second;
+}
+
+void CReplay::run()
+{
+	if (total == 0)
+		total = requests.size();
+	results.reserve(total);
+	next = 0;
+	startTime = now();
+
+	vector<thread> workers;
+	for (int i = 0; i < concurrency; i++)
+		workers.push_back(thread(&CReplay::worker, this));
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+static void printPercentiles(const char* label, const vector<int64_t>& sorted)
+{
+	const double pct[] = { 0.50, 0.95, 0.99, 0.999 };
+	const char* names[] = { "p50", "p95", "p99", "p999" };
+	printf("%s", label);
+	for (size_t i = 0; i < sizeof(pct) / sizeof(pct[0]); i++) {
+		size_t idx = static_cast<size_t>(pct[i] * static_cast<double>(sorted.size()) + 0.999999);
+		idx = (idx > 0) ? idx - 1 : 0;
+		printf(" %s %.3f ms", names[i], static_cast<double>(sorted[min(idx, sorted.size() - 1)]) / 1e6);
+	}
+	printf(" max %.3f ms\n", static_cast<double>(sorted.back()) / 1e6);
+}
+
+void CReplay::report()
+{
+	double duration = static_cast<double>(now() - startTime) / 1e9;
+	vector<int64_t> lat, first;
+	uint64_t errors = 0, bytes = 0;
+	for (size_t i = 0; i < results.size(); i++) {
+		lat.push_back(results[i].latency);
+		first.push_back(results[i].firstByte);
+		bytes += results[i].bytes;
+		if ((results[i].status == 0) || (results[i].status >= 400))
+			errors++;
+	}
+	sort(lat.begin(), lat.end());
+	sort(first.begin(), first.end());
+
+	printf("requests    %zu (errors %llu, skipped from log %d)\n", results.size(), static_cast<unsigned long long>(errors), skipped);
+	printf("duration    %.3f s\n", duration);
+	printf("throughput  %.1f req/s, %.1f KiB/s\n", (duration > 0) ? static_cast<double>(results.size()) / duration : 0.0,
+	       (duration > 0) ? static_cast<double>(bytes) / 1024.0 / duration : 0.0);
+	if (lat.empty())
+		return;
+
+	printPercentiles("latency    ", lat);
+	/* for CGI: fork/exec, dynamic linking and setup up to the first output */
+	printPercentiles("first byte ", first);
+	printf("status     ");
+	for (map<int, uint64_t>::iterator it = statusCount.begin(); it != statusCount.end(); ++it) {
+		if (it->first == 0)
+			printf(" failed=%llu", static_cast<unsigned long long>(it->second));
+		else
+			printf(" %d=%llu", it->first, static_cast<unsigned long long>(it->second));
+	}
+	printf("\n");
+}
+
+static void usage(const char* prog)
+{
+	printf("Usage: %s [options] <mt-api.requests.log>\n", prog);
+	printf("       %s [options] --query QUERY_STRING\n", prog);
+	printf("  --cgi PATH           run the CGI binary PATH per request (default target)\n");
+	printf("  --fcgi ADDR          FastCGI socket, host:port or unix:/path\n");
+	printf("  --http ADDR          HTTP listener, host:port or unix:/path\n");
+	printf("  -c, --concurrency N  parallel requests (default 1)\n");
+	printf("  -r, --rate N         requests per second, 0 = as fast as possible (default 0)\n");
+	printf("  -n, --requests N     number of requests, the log is repeated as needed\n");
+	printf("                       (default: each logged request once)\n");
+	printf("  --path PATH          script path / URL path (default /mt-api)\n");
+	printf("  --host NAME          SERVER_NAME and Host header (default localhost)\n");
+	printf("  --timeout MS         socket timeout (default 30000)\n");
+	printf("  --query QS           send the GET request QS instead of the logged ones,\n");
+	printf("                       e.g. to measure the CGI start (see \"first byte\")\n");
+	printf("  -h, --help           this help\n");
+}
+
+int main(int argc, char** argv)
+{
+	static const struct option longOpts[] = {
+		{ "cgi",		required_argument,	NULL, 'C' },
+		{ "fcgi",		required_argument,	NULL, 'F' },
+		{ "http",		required_argument,	NULL, 'H' },
+		{ "concurrency",	required_argument,	NULL, 'c' },
+		{ "rate",		required_argument,	NULL, 'r' },
+		{ "requests",		required_argument,	NULL, 'n' },
+		{ "path",		required_argument,	NULL, 'P' },
+		{ "host",		required_argument,	NULL, 'S' },
+		{ "timeout",		required_argument,	NULL, 'T' },
+		{ "query",		required_argument,	NULL, 'Q' },
+		{ "help",		no_argument,		NULL, 'h' },
+		{ NULL,			0,			NULL, 0 }
+	};
+
+	CReplay replay;
+	bool haveTarget = false;
+	bool haveQuery = false;
+	int opt;
+	while ((opt = getopt_long(argc, argv, "c:r:n:h", longOpts, NULL)) != -1) {
+		switch (opt) {
+			case 'C':	replay.setTarget(CReplay::targetCgi, optarg); haveTarget = true; break;
+			case 'F':	replay.setTarget(CReplay::targetFcgi, optarg); haveTarget = true; break;
+			case 'H':	replay.setTarget(CReplay::targetHttp, optarg); haveTarget = true; break;
+			case 'c':	replay.setConcurrency(atoi(optarg)); break;
+			case 'r':	replay.setRate(atof(optarg)); break;
+			case 'n':	replay.setTotal(strtoull(optarg, NULL, 10)); break;
+			case 'P':	replay.setScriptPath(optarg); break;
+			case 'S':	replay.setServerName(optarg); break;
+			case 'T':	replay.setTimeout(atoi(optarg)); break;
+			case 'Q':	replay.addRequest("GET", optarg, ""); haveQuery = true; break;
+			case 'h':	usage(argv[0]); return 0;
+			default:	usage(argv[0]); return 1;
+		}
+	}
+	if (!haveTarget || (optind != argc - ((haveQuery) ? 0 : 1))) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	if (!haveQuery) {
+		if (!replay.loadLog(argv[optind])) {
+			cerr << "No requests found in " << argv[optind] << endl;
+			return 1;
+		}
+		printf("replaying %zu logged requests\n", replay.getRequestCount());
+	}
+	replay.run();
+	replay.report();
+
+	return 0;
+}
@@ -0,0 +1,100 @@
+
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <mutex>
+
+using namespace std;
+
+/*
+ * Replays the requests recorded in mt-api.requests.log against a CGI
+ * binary, a FastCGI socket or an HTTP listener and reports throughput
+ * and latency percentiles.
+ */
+class CReplay
+{
+	public:
+		enum {
+			targetCgi,
+			targetFcgi,
+			targetHttp
+		};
+
+		struct request_t {
+			string method;
+			string query;
+			string body;
+		};
+
+	private:
+		struct result_t {
+			int64_t latency;
+			int64_t firstByte;
+			int status;
+			size_t bytes;
+		};
+
+		vector<request_t> requests;
+		int skipped;
+
+		int targetType;
+		string target;
+		string scriptPath;
+		string serverName;
+		int concurrency;
+		double rate;
+		uint64_t total;
+		int timeoutMs;
+
+		atomic<uint64_t> next;
+		int64_t startTime;
+		mutex resultLock;
+		vector<result_t> results;
+		map<int, uint64_t> statusCount;
+
+		static bool parseLine(const string& line, string& event, int& pid, map<string, string>& fields);
+		static string urlEncode(const string& in);
+		static int parseStatus(const string& head, bool http);
+		vector<pair<string, string> > cgiParams(const request_t& r);
+		int connectTarget();
+		bool readAll(int fd, string& out, int64_t* firstByte);
+
+		bool runCgi(const request_t& r, int& status, size_t& bytes, int64_t* firstByte);
+		bool runFcgi(const request_t& r, int& status, size_t& bytes, int64_t* firstByte);
+		bool runHttp(const request_t& r, int& status, size_t& bytes, int64_t* firstByte);
+		void worker();
+
+	public:
+		CReplay();
+
+		static int64_t now();
+
+		bool loadLog(string file);
+		void addRequest(string method, string query, string body);
+		size_t getRequestCount() { return requests.size(); };
+		int getSkipped() { return skipped; };
+
+		void setTarget(int type, string t) { targetType = type; target = t; };
+		void setScriptPath(string path) { scriptPath = path; };
+		void setServerName(string name) { serverName = name; };
+		void setConcurrency(int c) { concurrency = (c > 0) ? c : 1; };
+		void setRate(double r) { rate = (r > 0) ? r : 0; };
+		void setTotal(uint64_t n) { total = n; };
+		void setTimeout(int ms) { timeoutMs = (ms > 0) ? ms : 30000; };
+
+		void run();
+		void report();
+};
+
+
+#endif // __REPLAY_H__
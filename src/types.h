@@ -4,6 +4,7 @@
 
 #include <jsoncpp/json/json.h>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -96,6 +97,19 @@ typedef struct channels_t
 	time_t oldest;
 } channels_struct_t;
 
+typedef struct batchRequest_t
+{
+	int                   queryMode;
+	string                error;
+	cmdListVideo_t        clv;
+	listVideoHead_t       lvh;
+	int                   total;
+	vector<listVideo_t>   lv;
+	progInfo_t            pi;
+	vector<livestreams_t> ls;
+	vector<channels_t>    ch;
+} batchRequest_struct_t;
+
 typedef struct query_header_t
 {
 	string      software;
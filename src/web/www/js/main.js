@@ -38,6 +38,11 @@ function sqlBox(data, id) {
 	document.getElementById("sqlCode_" + id).innerHTML = "<pre>" + sql + "</pre>";
 }
 
+function sqlInfoBox(data, id) {
+	data = Base64.decode(data)
+	document.getElementById("sqlInfo_" + id).innerHTML = "<pre>" + data + "</pre>";
+}
+
 function sqlSpoiler() {
 	obj1 = document.getElementById('sql_0');
 	obj2 = document.getElementById('spoiler1_txt');
@@ -0,0 +1,152 @@
+
+#include <string>
+
+#include "workpool.h"
+
+thread_local int CWorkPool::workerIndex = -1;
+
+CWorkPool::CWorkPool() : CWorkPool(-1)
+{
+}
+
+/* count < 0: MT_API_WORKERS or the default */
+CWorkPool::CWorkPool(int count)
+{
+	pending		= 0;
+	nextQueue	= 0;
+	stopping	= false;
+
+	if (count < 0) {
+		const char* workersEnv = getenv("MT_API_WORKERS");
+		if (workersEnv && *workersEnv)
+			count = atoi(workersEnv);
+		else {
+			count = static_cast<int>(thread::hardware_concurrency()) - 1;
+			if (count > maxDefault)
+				count = maxDefault;
+		}
+	}
+	if (count < 0)
+		count = 0;
+
+	for (int i = 0; i < count; i++)
+		queues.push_back(unique_ptr<queue_t>(new queue_t));
+	for (int i = 0; i < count; i++)
+		threads.push_back(thread(&CWorkPool::worker, this, i));
+}
+
+CWorkPool::~CWorkPool()
+{
+	{
+		lock_guard<mutex> guard(waitLock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+}
+
+/* own deque from the back, then the others from the front (self < 0: only steal) */
+bool CWorkPool::pop(int self, task_t* task)
+{
+	size_t n = queues.size();
+	if (self >= 0) {
+		queue_t* q = queues[self].get();
+		lock_guard<mutex> guard(q->lock);
+		if (!q->tasks.empty()) {
+			*task = move(q->tasks.back());
+			q->tasks.pop_back();
+			pending--;
+			return true;
+		}
+	}
+	size_t start = (self >= 0) ? static_cast<size_t>(self) + 1 : 0;
+	for (size_t i = 0; i < n; i++) {
+		queue_t* q = queues[(start + i) % n].get();
+		lock_guard<mutex> guard(q->lock);
+		if (!q->tasks.empty()) {
+			*task = move(q->tasks.front());
+			q->tasks.pop_front();
+			pending--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void CWorkPool::worker(int index)
+{
+	workerIndex = index;
+	for (;;) {
+		task_t task;
+		if (pop(index, &task)) {
+			task();
+			continue;
+		}
+		unique_lock<mutex> guard(waitLock);
+		wake.wait(guard, [this]() { return (stopping || (pending.load() > 0)); });
+		if (stopping)
+			break;
+	}
+}
+
+void CWorkPool::submit(task_t task)
+{
+	if (threads.empty()) {
+		task();
+		return;
+	}
+
+	size_t q = ((workerIndex >= 0) && (static_cast<size_t>(workerIndex) < queues.size())) ?
+		   static_cast<size_t>(workerIndex) : nextQueue++ % queues.size();
+	{
+		lock_guard<mutex> guard(queues[q]->lock);
+		queues[q]->tasks.push_back(move(task));
+	}
+	pending++;
+	{
+		lock_guard<mutex> guard(waitLock);
+	}
+	wake.notify_one();
+}
+
+/* fn(0) .. fn(count - 1) on the pool and the calling thread, returns when all are done */
+void CWorkPool::parallelFor(size_t count, function<void(size_t)> fn)
+{
+	if (threads.empty() || (count < 2)) {
+		for (size_t i = 0; i < count; i++)
+			fn(i);
+		return;
+	}
+
+	/* remaining changes under doneLock only, the caller can't leave while a task still holds it */
+	size_t remaining = count;
+	mutex doneLock;
+	condition_variable done;
+	for (size_t i = 1; i < count; i++) {
+		submit([&, i]() {
+			fn(i);
+			lock_guard<mutex> guard(doneLock);
+			if (--remaining == 0)
+				done.notify_all();
+		});
+	}
+	fn(0);
+	{
+		lock_guard<mutex> guard(doneLock);
+		remaining--;
+	}
+
+	/* help out until the last task has finished */
+	for (;;) {
+		task_t task;
+		if (pop(workerIndex, &task)) {
+			task();
+			continue;
+		}
+		unique_lock<mutex> guard(doneLock);
+		if (remaining == 0)
+			break;
+		done.wait_for(guard, chrono::milliseconds(1));
+	}
+}
@@ -0,0 +1,74 @@
+
+#ifndef __WORKPOOL_H__
+#define __WORKPOOL_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Worker threads for the CPU work of a request, e.g. serializing a large
+ * page. Every worker owns a deque: it takes its own tasks from the back
+ * and, when that runs dry, steals from the front of the others. Tasks
+ * submitted by a worker stay in its deque, others are spread round-robin.
+ * The thread waiting in parallelFor() runs tasks as well, so the pool is
+ * never waited on by an idle caller.
+ *
+ * Database calls are not run here: the connection of a request is used
+ * by the request thread only.
+ *
+ * MT_API_WORKERS	threads (default: cores - 1, at most maxDefault; 0: inline)
+ */
+class CWorkPool
+{
+	public:
+		enum {
+			maxDefault	= 4
+		};
+
+		typedef function<void()> task_t;
+
+	private:
+		struct queue_t {
+			mutex lock;
+			deque<task_t> tasks;
+		};
+
+		vector<thread> threads;
+		vector<unique_ptr<queue_t>> queues;
+		mutex waitLock;
+		condition_variable wake;
+		atomic<size_t> pending;
+		atomic<size_t> nextQueue;
+		bool stopping;
+
+		static thread_local int workerIndex;
+
+		bool pop(int self, task_t* task);
+		void worker(int index);
+
+	public:
+		CWorkPool();
+		CWorkPool(int count);
+		~CWorkPool();
+
+		size_t size() { return threads.size(); };
+		void submit(task_t task);
+		void parallelFor(size_t count, function<void(size_t)> fn);
+};
+
+
+#endif // __WORKPOOL_H__